@@ -227,7 +227,13 @@ function diggler.loadMod(path)
 end
 
 function diggler.initMod(mod)
-  mod.init()
+  -- Textures registered by the mod are decoded in parallel once it's done
+  ffi.C.Diggler_Content_Registry_beginTextureBatch(diggler.gameInstance)
+  local status, err = pcall(mod.init)
+  ffi.C.Diggler_Content_Registry_endTextureBatch(diggler.gameInstance)
+  if not status then
+    error(err, 0)
+  end
   mod.status = diggler.MODSTATUS.INITIALIZED
 end
 
@@ -55,6 +55,10 @@ const mat4& Camera::getSkyMatrix() const {
   return m_skyMatrix;
 }
 
+const vec3& Camera::getPosition() const {
+  return m_position;
+}
+
 const vec3& Camera::getUp() const {
   return m_up;
 }
@@ -28,6 +28,7 @@ public:
   const mat4& getVMatrix() const;
   const mat4& getPVMatrix() const;
   const mat4& getSkyMatrix() const;
+  const vec3& getPosition() const;
   const vec3& getUp() const;
   const vec3& getLookAt() const;
 };
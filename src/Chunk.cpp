@@ -2,6 +2,7 @@
 
 #include "Platform.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <cstddef>
 
@@ -12,6 +13,9 @@
 #include <MurmurHash2.h>
 
 #include "GlobalProperties.hpp"
+#include "ChunkFaceMask.hpp"
+#include "ChunkMeshBuilder.hpp"
+#include "ChunkVisibility.hpp"
 #include "Game.hpp"
 #include "content/Registry.hpp"
 #include "network/msgtypes/BlockUpdate.hpp"
@@ -85,6 +89,9 @@ Chunk::Chunk(Game *G, WorldRef W, int X, int Y, int Z) :
   state(State::Unavailable),
   CH(*this) {
   dirty = true;
+  lodDirty = 0xFF;
+  faceConnectivity = ChunkVisibility::All;
+  occlusionFrame = 0;
   data = new Data;
   data->clear();
 
@@ -171,16 +178,29 @@ void Chunk::notifyChange(int x, int y, int z) {
 
   CH.add(x, y, z);
   if (GlobalProperties::IsClient) {
-    int u = x==CX-1?1:(x==0)?-1:0,
-      v = y==CY-1?1:(y==0)?-1:0,
-      w = z==CZ-1?1:(z==0)?-1:0;
-    ChunkRef nc;
-    if (u && (nc = W->getChunk(wcx+u, wcy, wcz)))
-      nc->markAsDirty();
-    if (v && (nc = W->getChunk(wcx, wcy+v, wcz)))
-      nc->markAsDirty();
-    if (w && (nc = W->getChunk(wcx, wcy, wcz+w)))
-      nc->markAsDirty();
+    // Neighbours' meshes depend on the blocks along their border: the outermost layer at full
+    // resolution, and as many layers as a cell is deep at lower levels of detail
+    const glm::ivec3 pos(x, y, z), size(CX, CY, CZ);
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int dir = -1; dir <= 1; dir += 2) {
+        const int dist = dir < 0 ? pos[axis] : size[axis] - 1 - pos[axis];
+        if (dist >= (1 << (LodLevels - 1)))
+          continue;
+        glm::ivec3 npos(wcx, wcy, wcz);
+        npos[axis] += dir;
+        ChunkRef nc = W->getChunk(npos.x, npos.y, npos.z);
+        if (!nc)
+          continue;
+        if (dist == 0) {
+          nc->markAsDirty();
+          continue;
+        }
+        for (int level = 1; level < LodLevels; ++level) {
+          if (dist < (1 << level))
+            nc->lodDirty |= 1 << level;
+        }
+      }
+    }
   }
 }
 
@@ -249,6 +269,8 @@ bool Chunk::blockHasExtdata(int x, int y, int z) {
 
 void Chunk::markAsDirty() {
   dirty = true;
+  lodDirty = 0xFF;
+  faceConnectivity = ChunkVisibility::All;
 }
 
 void Chunk::updateServer() {
@@ -285,24 +307,29 @@ void Chunk::updateClient() {
 #endif
   mut.lock();
   Content::Registry &CR = *G->CR;
-  Vertex vertex[CX * CY * CZ * 6 /* faces */ * 4 /* vertices */ / 2 /* face removing (HSR) makes a lower vert max */];
-  ushort idxOpaque[CX * CY * CZ * 6 /* faces */ * 6 /* indices */ / 2 /* HSR */],
-         idxTransp[CX*CY*CZ*6*6/2];
-  ushort v = 0, io = 0, it = 0;
+  ChunkMeshBuilder &mb = ChunkMeshBuilder::local();
+  mb.clear();
+  std::vector<Vertex> &vertex = mb.vertices;
 
-  BlockId bt, bn /*BlockNear*/;
+  ChunkFaceMask &mask = mb.faceMask;
+  mask.build(*this, CR);
+  mask.computeFaces();
+  faceConnectivity = ChunkVisibility::compute(mask);
+
+  BlockId bt;
   const Util::TexturePacker::Coord *tc;
-  for(int8 x = 0; x < CX; x++) {
+  for(int8 z = 0; z < CZ; z++) {
     for(int8 y = 0; y < CY; y++) {
-      for(int8 z = 0; z < CZ; z++) {
+      const int r = ChunkFaceMask::row(y, z);
+      // Only visit blocks that have at least one visible face
+      ChunkFaceMask::Row blocks = mask.meshedBlocks(y, z);
+      while (blocks) {
+        const int8 x = ChunkFaceMask::lowestBit(blocks) - 1;
+        const ChunkFaceMask::Row bit = blocks & -blocks;
+        blocks &= blocks - 1;
         const glm::ivec3 blockPos(x + wcx * CX, y + wcy * CY, z + wcz * CZ);
         bt = data->id[I(x,y,z)];
 
-        // Empty block?
-        if (bt == Content::BlockAirId ||
-          bt == Content::BlockIgnoreId)
-          continue;
-
 #if 0
         BlockType
           /* -X face*/
@@ -327,105 +354,277 @@ void Chunk::updateClient() {
           if (bNNZ == BlockTypeLava || bNZP == BlockTypeLava) { br.r = 1.6f; br.g = 1.2f; }
           if (bNZP == BlockTypeLava || bNPZ == BlockTypeLava) { tr.r = 1.6f; tr.g = 1.2f; }
           if (bNPZ == BlockTypeLava || bNZN == BlockTypeLava) { tl.r = 1.6f; tl.g = 1.2f; }
-          vertex[v++] = {x,     y,     z,     tc->x, tc->v, bl.r, bl.g, bl.b};
-          vertex[v++] = {x,     y,     z + 1, tc->u, tc->v, br.r, br.g, br.b};
-          vertex[v++] = {x,     y + 1, z,     tc->x, tc->y, tl.r, tl.g, tl.b};
-          vertex[v++] = {x,     y + 1, z + 1, tc->u, tc->y, tr.r, tr.g, tr.b};
+          vertex.push_back({x,     y,     z,     tc->x, tc->v, bl.r, bl.g, bl.b});
+          vertex.push_back({x,     y,     z + 1, tc->u, tc->v, br.r, br.g, br.b});
+          vertex.push_back({x,     y + 1, z,     tc->x, tc->y, tl.r, tl.g, tl.b});
+          vertex.push_back({x,     y + 1, z + 1, tc->u, tc->y, tr.r, tr.g, tr.b});
 #endif
 
-        GLushort *index; ushort i;
-        const bool transp = CR.isTransparent(bt);
-        if (transp) {
-          index = idxTransp;
-          i = it;
-        } else {
-          index = idxOpaque;
-          i = io;
-        }
+        const bool transp = mask.translucent[r] & bit;
+        // Transparent blocks' faces also depend on their neighbours' IDs, check them one by one
+        const auto faceVisible = [&](FaceDirection d, int dx, int dy, int dz) -> bool {
+          if (transp) {
+            return CR.isFaceVisible(bt, getBlockId(x + dx, y + dy, z + dz));
+          }
+          return mask.faces[static_cast<int>(d)][r] & bit;
+        };
 
         // View from negative x
-        bn = getBlockId(x - 1, y, z);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::XDec, -1, 0, 0)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::XDec, blockPos);
-          vertex[v++] = {x, y,     z,     tc->x, tc->v, .6f, .6f, .6f};
-          vertex[v++] = {x, y,     z + 1, tc->u, tc->v, .6f, .6f, .6f};
-          vertex[v++] = {x, y + 1, z,     tc->x, tc->y, .6f, .6f, .6f};
-          vertex[v++] = {x, y + 1, z + 1, tc->u, tc->y, .6f, .6f, .6f};
+          vertex.push_back({x, y,     z,     tc->x, tc->v, .6f, .6f, .6f});
+          vertex.push_back({x, y,     z + 1, tc->u, tc->v, .6f, .6f, .6f});
+          vertex.push_back({x, y + 1, z,     tc->x, tc->y, .6f, .6f, .6f});
+          vertex.push_back({x, y + 1, z + 1, tc->u, tc->y, .6f, .6f, .6f});
         }
 
         // View from positive x
-        bn = getBlockId(x + 1, y, z);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::XInc, 1, 0, 0)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::XInc, blockPos);
-          vertex[v++] = {x + 1, y,     z,     tc->u, tc->v, .6f, .6f, .6f};
-          vertex[v++] = {x + 1, y + 1, z,     tc->u, tc->y, .6f, .6f, .6f};
-          vertex[v++] = {x + 1, y,     z + 1, tc->x, tc->v, .6f, .6f, .6f};
-          vertex[v++] = {x + 1, y + 1, z + 1, tc->x, tc->y, .6f, .6f, .6f};
+          vertex.push_back({x + 1, y,     z,     tc->u, tc->v, .6f, .6f, .6f});
+          vertex.push_back({x + 1, y + 1, z,     tc->u, tc->y, .6f, .6f, .6f});
+          vertex.push_back({x + 1, y,     z + 1, tc->x, tc->v, .6f, .6f, .6f});
+          vertex.push_back({x + 1, y + 1, z + 1, tc->x, tc->y, .6f, .6f, .6f});
         }
 
         // Negative Y
-        bn = getBlockId(x, y - 1, z);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::YDec, 0, -1, 0)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::YDec, blockPos);
-          vertex[v++] = {x,     y,     z, tc->u, tc->v, .2f, .2f, .2f};
-          vertex[v++] = {x + 1, y,     z, tc->u, tc->y, .2f, .2f, .2f};
-          vertex[v++] = {x,     y, z + 1, tc->x, tc->v, .2f, .2f, .2f};
-          vertex[v++] = {x + 1, y, z + 1, tc->x, tc->y, .2f, .2f, .2f};
+          vertex.push_back({x,     y,     z, tc->u, tc->v, .2f, .2f, .2f});
+          vertex.push_back({x + 1, y,     z, tc->u, tc->y, .2f, .2f, .2f});
+          vertex.push_back({x,     y, z + 1, tc->x, tc->v, .2f, .2f, .2f});
+          vertex.push_back({x + 1, y, z + 1, tc->x, tc->y, .2f, .2f, .2f});
         }
 
         // Positive Y
-        bn = getBlockId(x, y + 1, z);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::YInc, 0, 1, 0)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::YInc, blockPos);
-          vertex[v++] = {x,     y + 1,     z, tc->x, tc->v, .8f, .8f, .8f};
-          vertex[v++] = {x,     y + 1, z + 1, tc->u, tc->v, .8f, .8f, .8f};
-          vertex[v++] = {x + 1, y + 1,     z, tc->x, tc->y, .8f, .8f, .8f};
-          vertex[v++] = {x + 1, y + 1, z + 1, tc->u, tc->y, .8f, .8f, .8f};
+          vertex.push_back({x,     y + 1,     z, tc->x, tc->v, .8f, .8f, .8f});
+          vertex.push_back({x,     y + 1, z + 1, tc->u, tc->v, .8f, .8f, .8f});
+          vertex.push_back({x + 1, y + 1,     z, tc->x, tc->y, .8f, .8f, .8f});
+          vertex.push_back({x + 1, y + 1, z + 1, tc->u, tc->y, .8f, .8f, .8f});
         }
 
         // Negative Z
-        bn = getBlockId(x, y, z - 1);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::ZDec, 0, 0, -1)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::ZDec, blockPos);
-          vertex[v++] = {x,     y,     z, tc->u, tc->v, .4f, .4f, .4f};
-          vertex[v++] = {x,     y + 1, z, tc->u, tc->y, .4f, .4f, .4f};
-          vertex[v++] = {x + 1, y,     z, tc->x, tc->v, .4f, .4f, .4f};
-          vertex[v++] = {x + 1, y + 1, z, tc->x, tc->y, .4f, .4f, .4f};
+          vertex.push_back({x,     y,     z, tc->u, tc->v, .4f, .4f, .4f});
+          vertex.push_back({x,     y + 1, z, tc->u, tc->y, .4f, .4f, .4f});
+          vertex.push_back({x + 1, y,     z, tc->x, tc->v, .4f, .4f, .4f});
+          vertex.push_back({x + 1, y + 1, z, tc->x, tc->y, .4f, .4f, .4f});
         }
 
         // Positive Z
-        bn = getBlockId(x, y, z + 1);
-        if (CR.isFaceVisible(bt, bn)) {
-          index[i++] = v; index[i++] = v+1; index[i++] = v+2;
-          index[i++] = v+2; index[i++] = v+1; index[i++] = v+3;
+        if (faceVisible(FaceDirection::ZInc, 0, 0, 1)) {
+          mb.addQuad(transp);
           tc = CR.blockTexCoord(bt, FaceDirection::ZInc, blockPos);
-          vertex[v++] = {x,     y,     z + 1, tc->x, tc->v, .4f, .4f, .4f};
-          vertex[v++] = {x + 1, y,     z + 1, tc->u, tc->v, .4f, .4f, .4f};
-          vertex[v++] = {x,     y + 1, z + 1, tc->x, tc->y, .4f, .4f, .4f};
-          vertex[v++] = {x + 1, y + 1, z + 1, tc->u, tc->y, .4f, .4f, .4f};
+          vertex.push_back({x,     y,     z + 1, tc->x, tc->v, .4f, .4f, .4f});
+          vertex.push_back({x + 1, y,     z + 1, tc->u, tc->v, .4f, .4f, .4f});
+          vertex.push_back({x,     y + 1, z + 1, tc->x, tc->y, .4f, .4f, .4f});
+          vertex.push_back({x + 1, y + 1, z + 1, tc->u, tc->y, .4f, .4f, .4f});
         }
+      }
+    }
+  }
+
+#if CHUNK_TIPSIFY
+  mb.tipsify(CHUNK_TIPSIFY_CACHE_SIZE);
+#endif
+
+  G->R->renderers.world->updateChunk(this, 0, mb.view());
+  dirty = false;
+  mut.unlock();
+}
 
-        if (transp) {
-          it = i;
-        } else {
-          io = i;
+/**
+ * Corners of a cube face, in the same order as Chunk::updateClient emits them.
+ * `s` picks the texture's right edge instead of its left one, `t` its top instead of bottom.
+ */
+struct LodFaceCorner {
+  uint8 x, y, z;
+  bool s, t;
+};
+static const struct LodFace {
+  FaceDirection dir;
+  int8 dx, dy, dz;
+  float shade;
+  LodFaceCorner corners[4];
+} LodFaces[6] = {
+  { FaceDirection::XDec, -1, 0, 0, .6f,
+    {{0, 0, 0, false, false}, {0, 0, 1, true, false}, {0, 1, 0, false, true}, {0, 1, 1, true, true}} },
+  { FaceDirection::XInc, 1, 0, 0, .6f,
+    {{1, 0, 0, true, false}, {1, 1, 0, true, true}, {1, 0, 1, false, false}, {1, 1, 1, false, true}} },
+  { FaceDirection::YDec, 0, -1, 0, .2f,
+    {{0, 0, 0, true, false}, {1, 0, 0, true, true}, {0, 0, 1, false, false}, {1, 0, 1, false, true}} },
+  { FaceDirection::YInc, 0, 1, 0, .8f,
+    {{0, 1, 0, false, false}, {0, 1, 1, true, false}, {1, 1, 0, false, true}, {1, 1, 1, true, true}} },
+  { FaceDirection::ZDec, 0, 0, -1, .4f,
+    {{0, 0, 0, true, false}, {0, 1, 0, true, true}, {1, 0, 0, false, false}, {1, 1, 0, false, true}} },
+  { FaceDirection::ZInc, 0, 0, 1, .4f,
+    {{0, 0, 1, false, false}, {1, 0, 1, true, false}, {0, 1, 1, false, true}, {1, 1, 1, true, true}} },
+};
+
+/// @returns Index of the given direction in LodFaces, whose order differs from FaceDirection's.
+static int lodFaceIndex(FaceDirection dir) {
+  for (int i = 0; i < 6; ++i) {
+    if (LodFaces[i].dir == dir)
+      return i;
+  }
+  return -1;
+}
+
+void Chunk::updateClientLod(uint8 level) {
+  if (level == 0) {
+    return updateClient();
+  }
+#if CHUNK_INMEM_COMPRESS
+  imcUncompress();
+#endif
+  mut.lock();
+  Content::Registry &CR = *G->CR;
+  const int f = 1 << level, nx = CX >> level, ny = CY >> level, nz = CZ >> level;
+
+  // Downsample: a cell is opaque if at least half of its blocks are, taking the ID of its most
+  // common opaque block. Failing that, it is transparent if at least half of its blocks are
+  // non-air, taking the ID of its most common transparent block (e.g. water, glass). Rounding
+  // towards solid keeps thin surfaces from vanishing.
+  struct Vote { BlockId id; int count; };
+  std::vector<Vote> opaqueVotes, transpVotes;
+  const auto addVote = [](std::vector<Vote> &votes, BlockId id) {
+    auto it = std::find_if(votes.begin(), votes.end(),
+      [id](const Vote &v) { return v.id == id; });
+    if (it == votes.end()) {
+      votes.push_back({id, 1});
+    } else {
+      ++it->count;
+    }
+  };
+  const auto mostVoted = [](const std::vector<Vote> &votes) {
+    return std::max_element(votes.begin(), votes.end(),
+      [](const Vote &a, const Vote &b) { return a.count < b.count; })->id;
+  };
+  const auto voteCell = [&](const BlockId *ids, int cx, int cy, int cz) -> BlockId {
+    opaqueVotes.clear();
+    transpVotes.clear();
+    int opaque = 0, transp = 0;
+    for (int z = cz * f; z < (cz + 1) * f; ++z) {
+      for (int y = cy * f; y < (cy + 1) * f; ++y) {
+        for (int x = cx * f; x < (cx + 1) * f; ++x) {
+          const BlockId id = ids[I(x, y, z)];
+          if (id == Content::BlockAirId || id == Content::BlockIgnoreId) {
+            continue;
+          }
+          if (CR.isTransparent(id)) {
+            ++transp;
+            addVote(transpVotes, id);
+          } else {
+            ++opaque;
+            addVote(opaqueVotes, id);
+          }
         }
       }
     }
+    if (opaque * 2 >= f * f * f) {
+      return mostVoted(opaqueVotes);
+    }
+    if (transp > 0 && (opaque + transp) * 2 >= f * f * f) {
+      return mostVoted(transpVotes);
+    }
+    return Content::BlockAirId;
+  };
+
+  std::vector<BlockId> cells(nx * ny * nz);
+  for (int cz = 0; cz < nz; ++cz) {
+    for (int cy = 0; cy < ny; ++cy) {
+      for (int cx = 0; cx < nx; ++cx) {
+        cells[cx + nx * (cy + ny * cz)] = voteCell(data->id, cx, cy, cz);
+      }
+    }
   }
 
-  G->R->renderers.world->updateChunk(this, vertex, v, idxOpaque, io, idxTransp, it);
-  dirty = false;
+  // Cells beyond the chunk's border are downsampled from the neighbouring chunk the same way,
+  // so that neighbours drawn at the same level agree on which faces are hidden. Missing
+  // neighbours hide the faces facing them, as with full resolution meshes.
+  ChunkRef neighbours[6];
+  for (int i = 0; i < 6; ++i) {
+    const LodFace &face = LodFaces[i];
+    neighbours[i] = W->getChunk(wcx + face.dx, wcy + face.dy, wcz + face.dz);
+#if CHUNK_INMEM_COMPRESS
+    if (neighbours[i]) {
+      neighbours[i]->imcUncompress();
+    }
+#endif
+  }
+  const auto neighbourCell = [&](int i, int cx, int cy, int cz) -> BlockId {
+    const LodFace &face = LodFaces[i];
+    cx += face.dx; cy += face.dy; cz += face.dz;
+    if (cx >= 0 && cy >= 0 && cz >= 0 && cx < nx && cy < ny && cz < nz) {
+      return cells[cx + nx * (cy + ny * cz)];
+    }
+    if (!neighbours[i]) {
+      return Content::BlockIgnoreId;
+    }
+    return voteCell(neighbours[i]->data->id, (cx + nx) % nx, (cy + ny) % ny, (cz + nz) % nz);
+  };
+
+  ChunkMeshBuilder &mb = ChunkMeshBuilder::local();
+  mb.clear();
+  // Connectivity always comes from full resolution blocks: which chunks get culled mustn't
+  // depend on the level they're drawn at
+  mb.faceMask.build(*this, CR);
+  faceConnectivity = ChunkVisibility::compute(mb.faceMask);
+  static const int top = lodFaceIndex(FaceDirection::YInc);
+  for (int cz = 0; cz < nz; ++cz) {
+    for (int cy = 0; cy < ny; ++cy) {
+      for (int cx = 0; cx < nx; ++cx) {
+        const BlockId bt = cells[cx + nx * (cy + ny * cz)];
+        if (bt == Content::BlockAirId)
+          continue;
+        const bool transp = CR.isTransparent(bt);
+        bool visible[6];
+        for (int i = 0; i < 6; ++i) {
+          const BlockId n = neighbourCell(i, cx, cy, cz);
+          visible[i] = n != Content::BlockIgnoreId && CR.isFaceVisible(bt, n);
+        }
+        const glm::ivec3 blockPos(cx * f + wcx * CX, cy * f + wcy * CY, cz * f + wcz * CZ);
+        for (int i = 0; i < 6; ++i) {
+          const LodFace &face = LodFaces[i];
+          if (!visible[i]) {
+            // Neighbours drawn at another level of detail don't line up with this one's
+            // surface. Exposed cells on the X and Z borders keep their outer side as a flap
+            // hanging one cell down from their top, covering the crack; where levels match,
+            // it stays hidden behind the neighbour's blocks.
+            const bool border = (face.dx < 0 && cx == 0) || (face.dx > 0 && cx == nx - 1) ||
+              (face.dz < 0 && cz == 0) || (face.dz > 0 && cz == nz - 1);
+            if (!border || !visible[top] || !neighbours[i])
+              continue;
+          }
+          mb.addQuad(transp);
+          const Util::TexturePacker::Coord *tc = CR.blockTexCoord(bt, face.dir, blockPos);
+          for (const LodFaceCorner &c : face.corners) {
+            mb.vertices.push_back({
+              static_cast<float>((cx + c.x) * f),
+              static_cast<float>((cy + c.y) * f),
+              static_cast<float>((cz + c.z) * f),
+              c.s ? tc->u : tc->x, c.t ? tc->y : tc->v,
+              face.shade, face.shade, face.shade });
+          }
+        }
+      }
+    }
+  }
+
+#if CHUNK_TIPSIFY
+  mb.tipsify(CHUNK_TIPSIFY_CACHE_SIZE);
+#endif
+
+  G->R->renderers.world->updateChunk(this, level, mb.view());
+  lodDirty &= ~(1 << level);
   mut.unlock();
 }
 
@@ -448,29 +647,45 @@ void Chunk::write(IO::OutStream &os) const {
   delete[] compressed;
 }
 
-void Chunk::read(IO::InStream &is) {
+bool Chunk::decode(IO::InStream &is, Data &out) {
   uint compressedSize = is.readU16();
   const uint targetDataSize = Chunk::AllocaSize;
   byte *compressedData = new byte[compressedSize];
   is.readData(compressedData, compressedSize);
 
+  bool ok = true;
   uint outLen = targetDataSize;
-  int rz = lzfx_decompress(compressedData, compressedSize, data, &outLen);
+  int rz = lzfx_decompress(compressedData, compressedSize, &out, &outLen);
   if (rz < 0 || outLen != targetDataSize) {
     if (rz < 0) {
-      Log(Error, TAG) << "Chunk[" << wcx << ',' << wcy << ' ' << wcz <<
-          "] LZFX decompression failed";
+      Log(Error, TAG) << "LZFX decompression failed";
     } else {
-      Log(Error, TAG) << "Chunk[" << wcx << ',' << wcy << ' ' << wcz <<
-          "] has bad size " << outLen << '/' << targetDataSize;
+      Log(Error, TAG) << "Chunk has bad size " << outLen << '/' << targetDataSize;
     }
+    ok = false;
   }
-  if (is.readU32() != MurmurHash2(data, outLen, 0xFA0C778C)) {
-    Log(Error, TAG) << "Chunk[" << wcx << ',' << wcy << ' ' << wcz <<
-        "] decompression gave bad chunk content";
+  if (is.readU32() != MurmurHash2(&out, outLen, 0xFA0C778C)) {
+    Log(Error, TAG) << "Decompression gave bad chunk content";
+    ok = false;
   }
 
   delete[] compressedData;
+  return ok;
+}
+
+void Chunk::read(IO::InStream &is) {
+  if (!decode(is, *data)) {
+    Log(Error, TAG) << "Chunk[" << wcx << ',' << wcy << ' ' << wcz << "] read failed";
+  }
+  onLoaded();
+}
+
+void Chunk::load(const Data &d) {
+  std::memcpy(data, &d, AllocaSize);
+  onLoaded();
+}
+
+void Chunk::onLoaded() {
   state = State::Ready;
 
   { ChunkRef nc;
@@ -12,10 +12,15 @@
 
 #define CHUNK_INMEM_COMPRESS 1
 #define CHUNK_INMEM_COMPRESS_DELAY 2000 /* ms */
+// Faces don't share vertices, so meshes are already at the optimal 2.0 ACMR; only useful if
+// vertices ever get merged.
+#define CHUNK_TIPSIFY 0
+#define CHUNK_TIPSIFY_CACHE_SIZE 16 /* vertices */
 
 namespace Diggler {
 
 class CaveGenerator;
+class ChunkFaceMask;
 class Game;
 class World;
 using WorldRef = std::shared_ptr<World>;
@@ -34,6 +39,7 @@ class Chunk {
 private:
   friend World;
   friend CaveGenerator;
+  friend ChunkFaceMask;
   friend class Render::WorldRenderer;
   uintptr_t rendererData;
 
@@ -46,6 +52,13 @@ public:
     (CZ > (CX > CY ? CX : CY) ? CZ : (CX > CY ? CX : CY));
     // * 1.4142135623f; but we're already at 2x the radius (i.e. diameter)
   constexpr static float MidX = CX/2.f, MidY = CY/2.f, MidZ = CZ/2.f;
+  /**
+   * Number of mesh levels of detail. Level `n` is downsampled by a factor of `2^n`, level 0
+   * being the full resolution mesh.
+   */
+  constexpr static int LodLevels = 4;
+  static_assert((CX >> (LodLevels - 1)) > 0 && (CY >> (LodLevels - 1)) > 0 &&
+    (CZ >> (LodLevels - 1)) > 0, "Chunk is too small for its levels of detail");
 
   const int wcx, wcy, wcz;
 
@@ -75,6 +88,20 @@ public:
     float r, g, b;
   };
 
+  /**
+   * Non-owning view of a built mesh, pointing into the storage it was built in.
+   * Opaque and transparent indices both refer to the same vertices.
+   */
+  struct MeshView {
+    const Vertex *vertices;
+    uint vertCount;
+    const void *indicesOpq;
+    uint idxOpqCount;
+    const void *indicesTpt;
+    uint idxTptCount;
+    uint8 indexSize; /**< Size of an index in bytes, either 2 or 4. */
+  };
+
   Game *const G;
   const WorldRef W;
 
@@ -84,6 +111,7 @@ private:
 
   State state;
   bool dirty;
+  uint8 lodDirty;
   std::mutex mut;
 
 public:
@@ -102,6 +130,13 @@ public:
   uint blkMem;
   State getState();
 
+  /**
+   * Pairs of faces linked through see-through blocks, see ChunkVisibility.
+   * All of them until computed, so that a Chunk never hides anything before being meshed.
+   */
+  uint16 faceConnectivity;
+  uint32 occlusionFrame; /**< Last ChunkOcclusionCuller run that reached this Chunk. */
+
   class ChangeHelper {
   private:
     Chunk &C;
@@ -187,6 +222,15 @@ public:
     return dirty;
   }
 
+  /**
+   * @brief Get if the mesh of a given level of detail needs to be rebuilt.
+   * @param level Level of detail, level 0 being the full resolution mesh.
+   * @return `true` if the mesh is out of date, `false` otherwise.
+   */
+  bool isDirty(uint8 level) const {
+    return level == 0 ? dirty : (lodDirty & (1 << level));
+  }
+
   /* ============ Setters ============ */
 
   /**
@@ -231,12 +275,36 @@ public:
   void markAsDirty();
 
   void updateClient();
+
+  /**
+   * @brief Rebuilds the mesh of a downsampled level of detail.
+   * Blocks are grouped in cubes of `2^level` blocks per side, each cube being turned into a
+   * single opaque, transparent or air cell by majority vote of its blocks. Cells on the border
+   * are checked against the neighbouring chunks' cells, and exposed ones get skirts covering
+   * cracks with neighbours drawn at other levels.
+   * @param level Level of detail, between 1 and LodLevels - 1.
+   */
+  void updateClientLod(uint8 level);
   void updateServer();
 
   /* ============ Serialization ============ */
 
   void write(IO::OutStream&) const;
   void read(IO::InStream&);
+
+  /**
+   * @brief Decompresses chunk data written by write() without touching any chunk, so that it
+   * can be done off the thread owning the world.
+   * @returns false if the data is corrupt.
+   */
+  static bool decode(IO::InStream&, Data &out);
+  /**
+   * @brief Takes decoded data as the chunk's content, as read() does.
+   */
+  void load(const Data&);
+
+private:
+  void onLoaded();
 };
 
 using ChunkRef = std::shared_ptr<Chunk>;
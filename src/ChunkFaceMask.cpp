@@ -0,0 +1,136 @@
+#include "ChunkFaceMask.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+#include "content/Registry.hpp"
+#include "World.hpp"
+
+namespace Diggler {
+
+constexpr static int CX = Chunk::CX, CY = Chunk::CY, CZ = Chunk::CZ;
+static constexpr int I(int x, int y, int z) {
+  return x + y*CX + z*CX*CY;
+}
+
+static constexpr int F(FaceDirection d) {
+  return static_cast<int>(d);
+}
+
+void ChunkFaceMask::build(Chunk &c, const Content::Registry &CR) {
+  std::memset(transparent, 0, sizeof(transparent));
+
+  const BlockId *const ids = c.data->id;
+  for (int z = 0; z < CZ; ++z) {
+    for (int y = 0; y < CY; ++y) {
+      Row t = 0, o = 0, tl = 0;
+      for (int x = 0; x < CX; ++x) {
+        const BlockId id = ids[I(x, y, z)];
+        const Row bit = Row(1) << (x + 1);
+        if (CR.isTransparent(id)) {
+          t |= bit;
+          if (id != Content::BlockAirId) {
+            tl |= bit;
+          }
+        } else if (id != Content::BlockIgnoreId) {
+          o |= bit;
+        }
+      }
+      transparent[paddedRow(y, z)] = t;
+      opaque[row(y, z)] = o;
+      translucent[row(y, z)] = tl;
+    }
+  }
+
+  // Missing neighbours leave their border bits cleared, i.e. hide the faces facing them, as
+  // World::getBlockId returns BlockIgnoreId for them.
+  World &W = *c.W;
+  ChunkRef nc;
+  if ((nc = W.getChunk(c.wcx - 1, c.wcy, c.wcz))) {
+    for (int z = 0; z < CZ; ++z)
+      for (int y = 0; y < CY; ++y)
+        if (CR.isTransparent(nc->getBlockId(CX - 1, y, z)))
+          transparent[paddedRow(y, z)] |= Row(1);
+  }
+  if ((nc = W.getChunk(c.wcx + 1, c.wcy, c.wcz))) {
+    for (int z = 0; z < CZ; ++z)
+      for (int y = 0; y < CY; ++y)
+        if (CR.isTransparent(nc->getBlockId(0, y, z)))
+          transparent[paddedRow(y, z)] |= Row(1) << (CX + 1);
+  }
+  if ((nc = W.getChunk(c.wcx, c.wcy - 1, c.wcz))) {
+    for (int z = 0; z < CZ; ++z)
+      for (int x = 0; x < CX; ++x)
+        if (CR.isTransparent(nc->getBlockId(x, CY - 1, z)))
+          transparent[paddedRow(-1, z)] |= Row(1) << (x + 1);
+  }
+  if ((nc = W.getChunk(c.wcx, c.wcy + 1, c.wcz))) {
+    for (int z = 0; z < CZ; ++z)
+      for (int x = 0; x < CX; ++x)
+        if (CR.isTransparent(nc->getBlockId(x, 0, z)))
+          transparent[paddedRow(CY, z)] |= Row(1) << (x + 1);
+  }
+  if ((nc = W.getChunk(c.wcx, c.wcy, c.wcz - 1))) {
+    for (int y = 0; y < CY; ++y)
+      for (int x = 0; x < CX; ++x)
+        if (CR.isTransparent(nc->getBlockId(x, y, CZ - 1)))
+          transparent[paddedRow(y, -1)] |= Row(1) << (x + 1);
+  }
+  if ((nc = W.getChunk(c.wcx, c.wcy, c.wcz + 1))) {
+    for (int y = 0; y < CY; ++y)
+      for (int x = 0; x < CX; ++x)
+        if (CR.isTransparent(nc->getBlockId(x, y, 0)))
+          transparent[paddedRow(y, CZ)] |= Row(1) << (x + 1);
+  }
+}
+
+void ChunkFaceMask::computeFaces() {
+  // Rows of a given Z are contiguous along Y in both padded and non-padded arrays, so Y
+  // neighbours are at ±1 and Z neighbours at ±PaddedRowStride.
+#if defined(__SSE2__)
+  // Processes 4 rows of 32 bits at once
+  if (sizeof(Row) == 4 && CY % 4 == 0) {
+    for (int z = 0; z < CZ; ++z) {
+      for (int y = 0; y < CY; y += 4) {
+        const int r = row(y, z), p = paddedRow(y, z);
+        const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&opaque[r])),
+          t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&transparent[p])),
+          tyn = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&transparent[p - 1])),
+          typ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&transparent[p + 1])),
+          tzn = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&transparent[p - PaddedRowStride])),
+          tzp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&transparent[p + PaddedRowStride]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::XDec)][r]),
+          _mm_and_si128(o, _mm_slli_epi32(t, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::XInc)][r]),
+          _mm_and_si128(o, _mm_srli_epi32(t, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::YDec)][r]),
+          _mm_and_si128(o, tyn));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::YInc)][r]),
+          _mm_and_si128(o, typ));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::ZDec)][r]),
+          _mm_and_si128(o, tzn));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&faces[F(FaceDirection::ZInc)][r]),
+          _mm_and_si128(o, tzp));
+      }
+    }
+    return;
+  }
+#endif
+  for (int z = 0; z < CZ; ++z) {
+    for (int y = 0; y < CY; ++y) {
+      const int r = row(y, z), p = paddedRow(y, z);
+      const Row o = opaque[r];
+      faces[F(FaceDirection::XDec)][r] = o & (transparent[p] << 1);
+      faces[F(FaceDirection::XInc)][r] = o & (transparent[p] >> 1);
+      faces[F(FaceDirection::YDec)][r] = o & transparent[p - 1];
+      faces[F(FaceDirection::YInc)][r] = o & transparent[p + 1];
+      faces[F(FaceDirection::ZDec)][r] = o & transparent[p - PaddedRowStride];
+      faces[F(FaceDirection::ZInc)][r] = o & transparent[p + PaddedRowStride];
+    }
+  }
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef DIGGLER_CHUNK_FACE_MASK_HPP
+#define DIGGLER_CHUNK_FACE_MASK_HPP
+
+#include <type_traits>
+
+#include "Chunk.hpp"
+
+namespace Diggler {
+
+namespace Content {
+class Registry;
+}
+
+///
+/// @brief Per-row block visibility bitmasks of a Chunk.
+/// Each row runs along the X axis and stores one bit per block, allowing the visible faces of
+/// a whole row to be determined with a handful of shifts and ANDs instead of 6 neighbour
+/// lookups per block.
+///
+/// Bit `x + 1` of a row maps to block `x`; bits 0 and `CX + 1` hold the neighbouring chunks'
+/// blocks, so that faces on chunk borders are handled like any other.
+///
+class ChunkFaceMask {
+public:
+  using Row = std::conditional<Chunk::CX + 2 <= 32, uint32, uint64>::type;
+  static_assert(Chunk::CX + 2 <= sizeof(Row) * 8, "Chunk rows don't fit in a ChunkFaceMask::Row");
+
+  constexpr static int
+    RowCount = Chunk::CY * Chunk::CZ,
+    PaddedRowStride = Chunk::CY + 2,
+    PaddedRowCount = PaddedRowStride * (Chunk::CZ + 2);
+
+  ///
+  /// @returns Index of the (y, z) row in non-padded arrays.
+  ///
+  constexpr static int row(int y, int z) {
+    return y + z * Chunk::CY;
+  }
+
+  ///
+  /// @returns Index of the (y, z) row in padded arrays; y and z range from -1 to C{Y,Z}.
+  ///
+  constexpr static int paddedRow(int y, int z) {
+    return (y + 1) + (z + 1) * PaddedRowStride;
+  }
+
+  /// Blocks through which faces are seen (e.g. air), including neighbouring chunks' borders.
+  Row transparent[PaddedRowCount];
+  /// Opaque blocks that produce geometry.
+  Row opaque[RowCount];
+  /// Transparent blocks that produce geometry. Their faces can't be culled by opacity alone.
+  Row translucent[RowCount];
+  /// Visible faces of opaque blocks, indexed by FaceDirection.
+  Row faces[6][RowCount];
+
+  ///
+  /// @brief Fills in the masks from the Chunk and its 6 direct neighbours' blocks.
+  /// @note The Chunk's data must be uncompressed.
+  ///
+  void build(Chunk&, const Content::Registry&);
+
+  ///
+  /// @brief Computes visible faces of opaque blocks from the opacity masks.
+  /// Uses SSE2 when available and rows are 32-bit.
+  ///
+  void computeFaces();
+
+  ///
+  /// @returns Index of the lowest set bit of a non-zero row.
+  ///
+  constexpr static int lowestBit(Row r) {
+    return sizeof(Row) == sizeof(unsigned int) ? __builtin_ctz(r) : __builtin_ctzll(r);
+  }
+
+  ///
+  /// @returns Bits of all blocks in row (y, z) that have geometry to emit.
+  ///
+  inline Row meshedBlocks(int y, int z) const {
+    const int r = row(y, z);
+    return faces[0][r] | faces[1][r] | faces[2][r] | faces[3][r] | faces[4][r] | faces[5][r] |
+      translucent[r];
+  }
+};
+
+}
+
+#endif /* DIGGLER_CHUNK_FACE_MASK_HPP */
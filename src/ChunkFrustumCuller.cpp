@@ -0,0 +1,161 @@
+#include "ChunkFrustumCuller.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE__)
+  #include <xmmintrin.h>
+#endif
+
+#include "Frustum.hpp"
+
+namespace Diggler {
+
+constexpr static int CX = Chunk::CX, CY = Chunk::CY, CZ = Chunk::CZ;
+constexpr static int RS = ChunkFrustumCuller::RegionSize;
+
+namespace {
+
+// Single precision planes, with the offsets to a box's corners folded into the distance
+struct BoxPlanes {
+  float nx[6], ny[6], nz[6];
+  float dFar[6] /* to the corner furthest along the normal */,
+    dNear[6] /* to the corner nearest */;
+
+  BoxPlanes(const Frustum &f, float sx, float sy, float sz) {
+    for (int i = 0; i < 6; ++i) {
+      const Frustum::Plane &p = f.pl[i];
+      nx[i] = p.normal.x;
+      ny[i] = p.normal.y;
+      nz[i] = p.normal.z;
+      const float far = std::max(nx[i], 0.f) * sx + std::max(ny[i], 0.f) * sy +
+          std::max(nz[i], 0.f) * sz,
+        near = std::min(nx[i], 0.f) * sx + std::min(ny[i], 0.f) * sy +
+          std::min(nz[i], 0.f) * sz;
+      dFar[i] = p.d + far;
+      dNear[i] = p.d + near;
+    }
+  }
+
+  enum Result { Outside, Straddling, Inside };
+
+  Result test(float x, float y, float z) const {
+    Result r = Inside;
+    for (int i = 0; i < 6; ++i) {
+      const float dist = nx[i] * x + ny[i] * y + nz[i] * z;
+      if (dist + dFar[i] < 0) {
+        return Outside;
+      }
+      if (dist + dNear[i] < 0) {
+        r = Straddling;
+      }
+    }
+    return r;
+  }
+};
+
+}
+
+ChunkFrustumCuller::ChunkFrustumCuller() :
+  stats{} {
+}
+
+static glm::ivec3 regionOf(const Chunk &c) {
+  return glm::ivec3(divrd(c.wcx, RS), divrd(c.wcy, RS), divrd(c.wcz, RS));
+}
+
+void ChunkFrustumCuller::add(Chunk *c) {
+  Region &r = m_regions[regionOf(*c)];
+  r.chunks.push_back(c);
+  r.x.push_back(c->wcx * CX);
+  r.y.push_back(c->wcy * CY);
+  r.z.push_back(c->wcz * CZ);
+}
+
+void ChunkFrustumCuller::remove(Chunk *c) {
+  auto rit = m_regions.find(regionOf(*c));
+  if (rit == m_regions.end()) {
+    return;
+  }
+  Region &r = rit->second;
+  auto it = std::find(r.chunks.begin(), r.chunks.end(), c);
+  if (it == r.chunks.end()) {
+    return;
+  }
+  // Swap with the last chunk to keep arrays packed
+  const size_t i = it - r.chunks.begin(), last = r.chunks.size() - 1;
+  r.chunks[i] = r.chunks[last]; r.chunks.pop_back();
+  r.x[i] = r.x[last]; r.x.pop_back();
+  r.y[i] = r.y[last]; r.y.pop_back();
+  r.z[i] = r.z[last]; r.z.pop_back();
+  if (r.chunks.empty()) {
+    m_regions.erase(rit);
+  }
+}
+
+void ChunkFrustumCuller::cull(const Frustum &f, std::vector<Chunk*> &visible) {
+  stats = Stats{};
+  const BoxPlanes regionPlanes(f, RS * CX, RS * CY, RS * CZ), chunkPlanes(f, CX, CY, CZ);
+  for (auto &pair : m_regions) {
+    const glm::ivec3 &rpos = pair.first;
+    Region &r = pair.second;
+    const uint count = r.chunks.size();
+    switch (regionPlanes.test(rpos.x * RS * CX, rpos.y * RS * CY, rpos.z * RS * CZ)) {
+    case BoxPlanes::Outside:
+      ++stats.regionsCulled;
+      stats.chunksCulled += count;
+      continue;
+    case BoxPlanes::Inside:
+      ++stats.regionsInside;
+      stats.chunksVisible += count;
+      visible.insert(visible.end(), r.chunks.begin(), r.chunks.end());
+      continue;
+    case BoxPlanes::Straddling:
+      ++stats.regionsStraddling;
+      break;
+    }
+
+    uint i = 0;
+#if defined(__SSE__)
+    for (; i + 4 <= count; i += 4) {
+      const __m128 x = _mm_loadu_ps(&r.x[i]), y = _mm_loadu_ps(&r.y[i]),
+        z = _mm_loadu_ps(&r.z[i]);
+      __m128 in = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+      for (int p = 0; p < 6; ++p) {
+        const __m128 dist = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(chunkPlanes.nx[p]), x),
+            _mm_mul_ps(_mm_set1_ps(chunkPlanes.ny[p]), y)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(chunkPlanes.nz[p]), z),
+            _mm_set1_ps(chunkPlanes.dFar[p])));
+        in = _mm_and_ps(in, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+      }
+      const int mask = _mm_movemask_ps(in);
+      for (int b = 0; b < 4; ++b) {
+        if (mask & (1 << b)) {
+          visible.push_back(r.chunks[i + b]);
+          ++stats.chunksVisible;
+        } else {
+          ++stats.chunksCulled;
+        }
+      }
+    }
+#endif
+    for (; i < count; ++i) {
+      if (chunkPlanes.test(r.x[i], r.y[i], r.z[i]) != BoxPlanes::Outside) {
+        visible.push_back(r.chunks[i]);
+        ++stats.chunksVisible;
+      } else {
+        ++stats.chunksCulled;
+      }
+    }
+  }
+}
+
+void ChunkFrustumCuller::forEach(const std::function<void(Chunk&)> &func) const {
+  for (const auto &pair : m_regions) {
+    for (Chunk *c : pair.second.chunks) {
+      func(*c);
+    }
+  }
+}
+
+}
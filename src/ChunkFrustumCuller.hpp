@@ -0,0 +1,52 @@
+#ifndef DIGGLER_CHUNK_FRUSTUM_CULLER_HPP
+#define DIGGLER_CHUNK_FRUSTUM_CULLER_HPP
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "World.hpp"
+
+namespace Diggler {
+
+class Frustum;
+
+///
+/// @brief Finds the chunks whose bounding box intersects a Frustum.
+/// Chunks are grouped in regions of RegionSize³ chunks, matching the spec's Areas; regions
+/// fully outside or inside the frustum are decided at once. Chunks of straddling regions are
+/// tested from flat arrays of bounds, 4 at a time when SSE is available.
+///
+class ChunkFrustumCuller {
+public:
+  constexpr static int RegionSize = 8; /**< Region size along each axis, in chunks. */
+
+  struct Stats {
+    uint regionsCulled, regionsInside, regionsStraddling;
+    uint chunksCulled, chunksVisible;
+  } stats;
+
+  ChunkFrustumCuller();
+
+  void add(Chunk*);
+  void remove(Chunk*);
+
+  ///
+  /// @brief Appends the chunks in the frustum to `visible`, and updates stats.
+  ///
+  void cull(const Frustum&, std::vector<Chunk*> &visible);
+
+  void forEach(const std::function<void(Chunk&)> &func) const;
+
+private:
+  struct Region {
+    std::vector<Chunk*> chunks;
+    // Chunks' minimum corners, in blocks
+    std::vector<float> x, y, z;
+  };
+  std::map<glm::ivec3, Region, WorldChunkMapSorter> m_regions;
+};
+
+}
+
+#endif /* DIGGLER_CHUNK_FRUSTUM_CULLER_HPP */
@@ -0,0 +1,82 @@
+#include "ChunkMeshBuilder.hpp"
+
+#include <memory>
+
+#include "util/Tipsify.hpp"
+
+namespace Diggler {
+
+ChunkMeshBuilder::ChunkMeshBuilder() :
+  wide(false) {
+}
+
+void ChunkMeshBuilder::clear() {
+  vertices.clear();
+  indicesOpq.clear();
+  indicesTpt.clear();
+  indicesOpq32.clear();
+  indicesTpt32.clear();
+  wide = false;
+}
+
+void ChunkMeshBuilder::promote() {
+  indicesOpq32.assign(indicesOpq.begin(), indicesOpq.end());
+  indicesTpt32.assign(indicesTpt.begin(), indicesTpt.end());
+  indicesOpq.clear();
+  indicesTpt.clear();
+  wide = true;
+}
+
+template<typename T>
+static void appendQuad(std::vector<T> &indices, T v) {
+  indices.insert(indices.end(), { v, T(v+1), T(v+2), T(v+2), T(v+1), T(v+3) });
+}
+
+void ChunkMeshBuilder::addQuad(bool transparent) {
+  if (!wide && vertices.size() + 4 > MaxNarrowVertices) {
+    promote();
+  }
+  if (wide) {
+    appendQuad<uint32>(transparent ? indicesTpt32 : indicesOpq32, vertices.size());
+  } else {
+    appendQuad<uint16>(transparent ? indicesTpt : indicesOpq, vertices.size());
+  }
+}
+
+void ChunkMeshBuilder::tipsify(uint cacheSize) {
+  if (wide) {
+    Util::Tipsify::tipsify(indicesOpq32.data(), indicesOpq32.size(), vertices.size(), cacheSize);
+    Util::Tipsify::tipsify(indicesTpt32.data(), indicesTpt32.size(), vertices.size(), cacheSize);
+  } else {
+    Util::Tipsify::tipsify(indicesOpq.data(), indicesOpq.size(), vertices.size(), cacheSize);
+    Util::Tipsify::tipsify(indicesTpt.data(), indicesTpt.size(), vertices.size(), cacheSize);
+  }
+}
+
+Chunk::MeshView ChunkMeshBuilder::view() const {
+  if (wide) {
+    return Chunk::MeshView {
+      vertices.data(), static_cast<uint>(vertices.size()),
+      indicesOpq32.data(), static_cast<uint>(indicesOpq32.size()),
+      indicesTpt32.data(), static_cast<uint>(indicesTpt32.size()),
+      sizeof(uint32)
+    };
+  }
+  return Chunk::MeshView {
+    vertices.data(), static_cast<uint>(vertices.size()),
+    indicesOpq.data(), static_cast<uint>(indicesOpq.size()),
+    indicesTpt.data(), static_cast<uint>(indicesTpt.size()),
+    sizeof(uint16)
+  };
+}
+
+ChunkMeshBuilder& ChunkMeshBuilder::local() {
+  // Allocated on first use so threads that never mesh don't pay for it
+  static thread_local std::unique_ptr<ChunkMeshBuilder> builder;
+  if (!builder) {
+    builder = std::make_unique<ChunkMeshBuilder>();
+  }
+  return *builder;
+}
+
+}
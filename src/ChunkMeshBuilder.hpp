@@ -0,0 +1,72 @@
+#ifndef DIGGLER_CHUNK_MESH_BUILDER_HPP
+#define DIGGLER_CHUNK_MESH_BUILDER_HPP
+
+#include <vector>
+
+#include "Chunk.hpp"
+#include "ChunkFaceMask.hpp"
+#include "platform/PreprocUtils.hpp"
+
+namespace Diggler {
+
+///
+/// @brief Scratch storage Chunk meshes are built into.
+/// Buffers keep their capacity between builds, so a thread meshing many chunks stops
+/// allocating once it has met its largest mesh, and mesh sizes aren't capped by fixed arrays.
+///
+/// Indices are 16-bit until the mesh outgrows them, at which point the mesh being built is
+/// promoted to 32-bit indices. The choice is made per mesh, so only the rare huge ones pay
+/// for it.
+///
+class ChunkMeshBuilder {
+public:
+  /// Highest vertex count 16-bit indices can address.
+  constexpr static uint MaxNarrowVertices = 65536;
+
+  std::vector<Chunk::Vertex> vertices;
+  /// 16-bit indices, used while `wide` is false.
+  std::vector<uint16> indicesOpq, indicesTpt;
+  /// 32-bit indices, used while `wide` is true.
+  std::vector<uint32> indicesOpq32, indicesTpt32;
+  /// Whether the mesh being built uses 32-bit indices.
+  bool wide;
+  ChunkFaceMask faceMask;
+
+  ChunkMeshBuilder();
+  nocopy(ChunkMeshBuilder);
+
+  ///
+  /// @brief Empties the mesh, keeping allocated storage, and goes back to 16-bit indices.
+  ///
+  void clear();
+
+  ///
+  /// @brief Appends the indices of a quad made of the next 4 vertices to be added.
+  /// Promotes the mesh to 32-bit indices if these vertices can't be addressed otherwise.
+  /// @param transparent Whether the quad goes in the transparent or opaque index list.
+  ///
+  void addQuad(bool transparent);
+
+  ///
+  /// @brief Reorders both index lists for vertex cache locality.
+  /// @see Util::Tipsify::tipsify
+  ///
+  void tipsify(uint cacheSize);
+
+  ///
+  /// @returns View of the built mesh, valid until this builder is modified.
+  ///
+  Chunk::MeshView view() const;
+
+  ///
+  /// @returns The calling thread's builder.
+  ///
+  static ChunkMeshBuilder& local();
+
+private:
+  void promote();
+};
+
+}
+
+#endif /* DIGGLER_CHUNK_MESH_BUILDER_HPP */
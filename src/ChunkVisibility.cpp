@@ -0,0 +1,170 @@
+#include "ChunkVisibility.hpp"
+
+#include <cmath>
+
+#include "ChunkFaceMask.hpp"
+#include "Frustum.hpp"
+#include "World.hpp"
+
+namespace Diggler {
+
+constexpr static int CX = Chunk::CX, CY = Chunk::CY, CZ = Chunk::CZ;
+
+static constexpr int F(FaceDirection d) {
+  return static_cast<int>(d);
+}
+
+static constexpr FaceDirection opposite(FaceDirection d) {
+  // Directions come in increasing/decreasing pairs
+  return static_cast<FaceDirection>(F(d) ^ 1);
+}
+
+static const glm::ivec3 FaceOffsets[6] = {
+  { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+};
+
+ChunkVisibility::Set ChunkVisibility::pair(FaceDirection a, FaceDirection b) {
+  // Rank of (a, b) among the 15 pairs of distinct faces
+  static const struct PairTable {
+    uint8 bit[6][6];
+    PairTable() {
+      int n = 0;
+      for (int i = 0; i < 6; ++i) {
+        bit[i][i] = 0;
+        for (int j = i + 1; j < 6; ++j) {
+          bit[i][j] = bit[j][i] = n++;
+        }
+      }
+    }
+  } table;
+  return Set(1) << table.bit[F(a)][F(b)];
+}
+
+ChunkVisibility::Set ChunkVisibility::compute(const ChunkFaceMask &mask) {
+  using Row = ChunkFaceMask::Row;
+  const Row fullRow = ((Row(1) << CX) - 1) << 1;
+  // Bits of see-through blocks not yet flooded, same layout as ChunkFaceMask rows
+  Row pending[ChunkFaceMask::RowCount];
+  bool allClear = true, anyClear = false;
+  for (int z = 0; z < CZ; ++z) {
+    for (int y = 0; y < CY; ++y) {
+      const Row r = mask.transparent[ChunkFaceMask::paddedRow(y, z)] & fullRow;
+      pending[ChunkFaceMask::row(y, z)] = r;
+      allClear &= r == fullRow;
+      anyClear |= r != 0;
+    }
+  }
+  if (allClear) {
+    return All;
+  }
+  if (!anyClear) {
+    return None;
+  }
+
+  static thread_local std::vector<uint16> stack;
+  Set result = None;
+  for (int z = 0; z < CZ; ++z) {
+    for (int y = 0; y < CY; ++y) {
+      Row &seeds = pending[ChunkFaceMask::row(y, z)];
+      while (seeds) {
+        // Flood the component containing the lowest pending block of this row
+        const int x0 = ChunkFaceMask::lowestBit(seeds) - 1;
+        seeds &= seeds - 1;
+        uint8 faces = 0;
+        stack.clear();
+        stack.push_back(x0 + (y + z * CY) * CX);
+        while (!stack.empty()) {
+          const int i = stack.back();
+          stack.pop_back();
+          const int x = i % CX, cy = (i / CX) % CY, cz = i / (CX * CY);
+          if (x == 0) faces |= 1 << F(FaceDirection::XDec);
+          if (x == CX - 1) faces |= 1 << F(FaceDirection::XInc);
+          if (cy == 0) faces |= 1 << F(FaceDirection::YDec);
+          if (cy == CY - 1) faces |= 1 << F(FaceDirection::YInc);
+          if (cz == 0) faces |= 1 << F(FaceDirection::ZDec);
+          if (cz == CZ - 1) faces |= 1 << F(FaceDirection::ZInc);
+          const auto visit = [&](int nx, int ny, int nz) {
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= CX || ny >= CY || nz >= CZ) {
+              return;
+            }
+            Row &r = pending[ChunkFaceMask::row(ny, nz)];
+            const Row bit = Row(1) << (nx + 1);
+            if (r & bit) {
+              r &= ~bit;
+              stack.push_back(nx + (ny + nz * CY) * CX);
+            }
+          };
+          visit(x - 1, cy, cz);
+          visit(x + 1, cy, cz);
+          visit(x, cy - 1, cz);
+          visit(x, cy + 1, cz);
+          visit(x, cy, cz - 1);
+          visit(x, cy, cz + 1);
+        }
+        for (int a = 0; a < 6; ++a) {
+          for (int b = a + 1; b < 6; ++b) {
+            if ((faces & (1 << a)) && (faces & (1 << b))) {
+              result |= pair(FaceDirection(a), FaceDirection(b));
+            }
+          }
+        }
+        if (result == All) {
+          return All;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+ChunkOcclusionCuller::ChunkOcclusionCuller() :
+  m_frame(0),
+  reached(0) {
+}
+
+bool ChunkOcclusionCuller::run(World &W, const glm::vec3 &cameraPos, const Frustum &frustum) {
+  ++m_frame;
+  reached = 0;
+  const glm::ivec3 camChunk(divrd(static_cast<int>(std::floor(cameraPos.x)), CX),
+    divrd(static_cast<int>(std::floor(cameraPos.y)), CY),
+    divrd(static_cast<int>(std::floor(cameraPos.z)), CZ));
+  ChunkRef start = W.getChunk(camChunk.x, camChunk.y, camChunk.z);
+  if (!start) {
+    return false;
+  }
+  m_queue.clear();
+  start->occlusionFrame = m_frame;
+  m_queue.push_back({ start, -1, 0 });
+  // m_queue is used as a FIFO whose consumed front is never erased; it is cleared every run
+  for (size_t head = 0; head < m_queue.size(); ++head) {
+    const Chunk &c = *m_queue[head].chunk;
+    const int8 from = m_queue[head].from;
+    const uint8 dirs = m_queue[head].dirs;
+    ++reached;
+    for (int d = 0; d < 6; ++d) {
+      const FaceDirection dir = static_cast<FaceDirection>(d);
+      if (dirs & (1 << F(opposite(dir)))) {
+        continue;
+      }
+      if (from >= 0 &&
+          !ChunkVisibility::connected(c.faceConnectivity, static_cast<FaceDirection>(from), dir)) {
+        continue;
+      }
+      const glm::ivec3 pos = c.getWorldChunkPos() + FaceOffsets[d];
+      ChunkRef n = W.getChunk(pos.x, pos.y, pos.z);
+      if (!n || n->occlusionFrame == m_frame) {
+        continue;
+      }
+      const vec3 min(pos.x * CX, pos.y * CY, pos.z * CZ);
+      if (!frustum.boxInFrustum(AABB<>(min, min + vec3(CX, CY, CZ)))) {
+        continue;
+      }
+      n->occlusionFrame = m_frame;
+      m_queue.push_back({ std::move(n), static_cast<int8>(F(opposite(dir))),
+        static_cast<uint8>(dirs | (1 << d)) });
+    }
+  }
+  return true;
+}
+
+}
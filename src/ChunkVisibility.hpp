@@ -0,0 +1,84 @@
+#ifndef DIGGLER_CHUNK_VISIBILITY_HPP
+#define DIGGLER_CHUNK_VISIBILITY_HPP
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "Chunk.hpp"
+#include "content/Registry.hpp"
+
+namespace Diggler {
+
+class ChunkFaceMask;
+class Frustum;
+class World;
+
+///
+/// @brief Face-to-face connectivity of a Chunk's see-through blocks.
+/// Records which pairs of the Chunk's 6 faces are linked by a path of see-through blocks, i.e.
+/// whether one can possibly see out of a face when looking in through another.
+///
+class ChunkVisibility {
+public:
+  /// Set of connected face pairs, one bit per unordered pair.
+  using Set = uint16;
+  constexpr static Set None = 0, All = (1 << 15) - 1;
+
+  ChunkVisibility() = delete;
+
+  ///
+  /// @returns Bit of the (a, b) face pair; a and b must differ.
+  ///
+  static Set pair(FaceDirection a, FaceDirection b);
+
+  static bool connected(Set s, FaceDirection a, FaceDirection b) {
+    return s & pair(a, b);
+  }
+
+  ///
+  /// @brief Computes a Chunk's connectivity by flood-filling its see-through blocks.
+  /// @param mask Face mask whose `transparent` rows have been built.
+  ///
+  static Set compute(const ChunkFaceMask &mask);
+};
+
+///
+/// @brief Finds potentially visible chunks by walking the chunk connectivity graph.
+/// Starting from the camera's Chunk, neighbours are visited through connected faces only, and
+/// never back towards the camera, so that chunks walled off by opaque blocks are never reached.
+///
+class ChunkOcclusionCuller {
+private:
+  struct Step {
+    ChunkRef chunk;
+    int8 from; /**< Face the chunk was entered through, -1 for the camera's Chunk. */
+    uint8 dirs; /**< Directions stepped so far, as FaceDirection bits. */
+  };
+  std::vector<Step> m_queue;
+  uint32 m_frame;
+
+public:
+  /// Number of chunks reached by the last run.
+  uint reached;
+
+  ChunkOcclusionCuller();
+
+  ///
+  /// @brief Marks the chunks visible from the camera.
+  /// @param frustum Chunks outside of it are neither marked nor walked through.
+  /// @returns `false` if the camera isn't in a loaded Chunk, in which case nothing is marked.
+  ///
+  bool run(World&, const glm::vec3 &cameraPos, const Frustum &frustum);
+
+  ///
+  /// @returns Whether the last run() reached the Chunk.
+  ///
+  bool isVisible(const Chunk &c) const {
+    return c.occlusionFrame == m_frame;
+  }
+};
+
+}
+
+#endif /* DIGGLER_CHUNK_VISIBILITY_HPP */
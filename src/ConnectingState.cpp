@@ -29,8 +29,10 @@ ConnectingState::ConnectingState(GameWindow *W, const std::string &servHost, int
   W(W),
   m_serverHost(servHost),
   m_serverPort(servPort) {
-  glfwSetInputMode(*W, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-  setupUI();
+  if (!W->isHeadless()) {
+    glfwSetInputMode(*W, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    setupUI();
+  }
 }
 
 ConnectingState::~ConnectingState() {
@@ -58,6 +60,7 @@ void ConnectingState::run() {
   std::thread networkThread = std::thread([G, &success, &finished, &serverHost, serverPort, &failureStr]() {
     try {
       G->H.create();
+      G->H.setCoalescing(true);
       G->NS = &G->H.connect(serverHost, serverPort, 5000);
       success = true;
     } catch (const std::exception &e) {
@@ -66,33 +69,40 @@ void ConnectingState::run() {
     }
     finished = true;
   });
-  glDisable(GL_CULL_FACE);
-  glDisable(GL_DEPTH_TEST);
-  glm::mat4 mat;
-
-  UI::Text::Size sz = txtConnecting->getSize();
-  const glm::mat4 textMat = glm::scale(glm::translate(*G->UIM->PM, glm::vec3(W->getW()/2-sz.x,
-      W->getH()/2, 0.f)), glm::vec3(2.f, 2.f, 1.f));
-  while (!finished && !W->shouldClose()) { // Infinite loop \o/
-    const double T = glfwGetTime();
-    G->updateTime(T);
-
-    G->R->beginFrame();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    txtConnecting->render(textMat);
-    for (int i=0; i < 6; ++i) {
-      const float t = T * 3 + 0.3f * i;
-      mat = glm::scale(glm::translate(*G->UIM->PM,
-        glm::vec3(W->getW()/2 - 1 + std::sin(t)*sz.x, W->getH()/2-sz.y, 0.f)),
-        glm::vec3(2.f, 2.f, 1.f));
-      txtDot->render(mat);
+  if (W->isHeadless()) {
+    Log(Info, TAG) << "Connecting to " << serverHost << ':' << serverPort;
+    while (!finished && !W->shouldClose()) {
+      G->updateTime(W->getTime());
+      W->present();
+    }
+  } else {
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glm::mat4 mat;
+
+    UI::Text::Size sz = txtConnecting->getSize();
+    const glm::mat4 textMat = glm::scale(glm::translate(*G->UIM->PM, glm::vec3(W->getW()/2-sz.x,
+        W->getH()/2, 0.f)), glm::vec3(2.f, 2.f, 1.f));
+    while (!finished && !W->shouldClose()) { // Infinite loop \o/
+      const double T = W->getTime();
+      G->updateTime(T);
+
+      G->R->beginFrame();
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      txtConnecting->render(textMat);
+      for (int i=0; i < 6; ++i) {
+        const float t = T * 3 + 0.3f * i;
+        mat = glm::scale(glm::translate(*G->UIM->PM,
+          glm::vec3(W->getW()/2 - 1 + std::sin(t)*sz.x, W->getH()/2-sz.y, 0.f)),
+          glm::vec3(2.f, 2.f, 1.f));
+        txtDot->render(mat);
+      }
+
+      G->R->endFrame();
+
+      W->present();
     }
-
-    G->R->endFrame();
-
-    glfwSwapBuffers(*W);
-    glfwPollEvents();
   }
   if (W->shouldClose())
     W->setVisible(false);
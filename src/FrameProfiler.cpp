@@ -0,0 +1,151 @@
+#include "FrameProfiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+namespace Diggler {
+
+const char* FrameStats::phaseName(Phase p) {
+  switch (p) {
+  case Phase::Network:
+    return "network";
+  case Phase::Physics:
+    return "physics";
+  case Phase::Culling:
+    return "culling";
+  case Phase::Meshing:
+    return "meshing";
+  case Phase::Draw:
+    return "draw";
+  case Phase::UI:
+    return "ui";
+  case Phase::Bloom:
+    return "bloom";
+  case Phase::Count:
+    break;
+  }
+  return "";
+}
+
+void FrameStats::reset() {
+  std::memset(this, 0, sizeof(*this));
+}
+
+FrameProfiler::Scope::~Scope() {
+  m_stats.phaseTime[static_cast<uint>(m_phase)] +=
+    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start).count();
+}
+
+FrameProfiler::FrameProfiler() :
+  m_head(0),
+  m_count(0) {
+  m_frames[0].reset();
+}
+
+void FrameProfiler::beginFrame() {
+  current().reset();
+  m_frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame() {
+  current().frameTime =
+    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_frameStart).count();
+  m_head = (m_head + 1) % HistorySize;
+  if (m_count < HistorySize - 1) {
+    // One slot is always left for the frame being recorded
+    ++m_count;
+  }
+  current().reset();
+}
+
+FrameStats FrameProfiler::average(uint count) const {
+  FrameStats avg;
+  avg.reset();
+  count = std::min(count, m_count);
+  if (count == 0) {
+    return avg;
+  }
+  for (uint i = m_count - count; i < m_count; ++i) {
+    const FrameStats &f = (*this)[i];
+    avg.frameTime += f.frameTime;
+    for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+      avg.phaseTime[p] += f.phaseTime[p];
+    }
+    avg.chunksConsidered += f.chunksConsidered;
+    avg.chunksCulled += f.chunksCulled;
+    avg.chunksDrawn += f.chunksDrawn;
+    for (uint l = 0; l < FrameStats::LodLevels; ++l) {
+      avg.lodChunksDrawn[l] += f.lodChunksDrawn[l];
+    }
+    avg.drawCalls += f.drawCalls;
+    avg.triangles += f.triangles;
+    avg.meshesRebuilt += f.meshesRebuilt;
+    avg.bytesUploaded += f.bytesUploaded;
+  }
+  avg.frameTime /= count;
+  for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+    avg.phaseTime[p] /= count;
+  }
+  avg.chunksConsidered /= count;
+  avg.chunksCulled /= count;
+  avg.chunksDrawn /= count;
+  for (uint l = 0; l < FrameStats::LodLevels; ++l) {
+    avg.lodChunksDrawn[l] /= count;
+  }
+  avg.drawCalls /= count;
+  avg.triangles /= count;
+  avg.meshesRebuilt /= count;
+  avg.bytesUploaded /= count;
+  return avg;
+}
+
+void FrameProfiler::writeCSV(std::ostream &os) const {
+  os << "frame_us";
+  for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+    os << ',' << FrameStats::phaseName(static_cast<FrameStats::Phase>(p)) << "_us";
+  }
+  os << ",chunks_considered,chunks_culled,chunks_drawn";
+  for (uint l = 0; l < FrameStats::LodLevels; ++l) {
+    os << ",chunks_drawn_lod" << l;
+  }
+  os << ",draw_calls,triangles,meshes_rebuilt,bytes_uploaded\n";
+  for (uint i = 0; i < m_count; ++i) {
+    const FrameStats &f = (*this)[i];
+    os << f.frameTime;
+    for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+      os << ',' << f.phaseTime[p];
+    }
+    os << ',' << f.chunksConsidered << ',' << f.chunksCulled << ',' << f.chunksDrawn;
+    for (uint l = 0; l < FrameStats::LodLevels; ++l) {
+      os << ',' << f.lodChunksDrawn[l];
+    }
+    os << ',' << f.drawCalls << ',' << f.triangles << ',' << f.meshesRebuilt << ',' <<
+      f.bytesUploaded << '\n';
+  }
+}
+
+void FrameProfiler::writeJSON(std::ostream &os) const {
+  os << '[';
+  for (uint i = 0; i < m_count; ++i) {
+    const FrameStats &f = (*this)[i];
+    os << (i == 0 ? "\n" : ",\n") << "{\"frame_us\":" << f.frameTime << ",\"phases_us\":{";
+    for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+      os << (p == 0 ? "\"" : ",\"") << FrameStats::phaseName(static_cast<FrameStats::Phase>(p)) <<
+        "\":" << f.phaseTime[p];
+    }
+    os << "},\"chunks_considered\":" << f.chunksConsidered <<
+      ",\"chunks_culled\":" << f.chunksCulled <<
+      ",\"chunks_drawn\":" << f.chunksDrawn << ",\"chunks_drawn_lod\":[";
+    for (uint l = 0; l < FrameStats::LodLevels; ++l) {
+      os << (l == 0 ? "" : ",") << f.lodChunksDrawn[l];
+    }
+    os << "],\"draw_calls\":" << f.drawCalls <<
+      ",\"triangles\":" << f.triangles <<
+      ",\"meshes_rebuilt\":" << f.meshesRebuilt <<
+      ",\"bytes_uploaded\":" << f.bytesUploaded << '}';
+  }
+  os << "\n]\n";
+}
+
+}
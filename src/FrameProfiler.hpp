@@ -0,0 +1,128 @@
+#ifndef DIGGLER_FRAME_PROFILER_HPP
+#define DIGGLER_FRAME_PROFILER_HPP
+
+#include <array>
+#include <chrono>
+#include <iosfwd>
+
+#include "platform/PreprocUtils.hpp"
+#include "platform/Types.hpp"
+
+namespace Diggler {
+
+///
+/// @brief Counters and CPU timings of a single frame.
+///
+struct FrameStats {
+  enum class Phase : uint8 {
+    Network,
+    Physics,
+    Culling,
+    Meshing,
+    Draw,
+    UI,
+    Bloom,
+
+    Count
+  };
+  constexpr static uint PhaseCount = static_cast<uint>(Phase::Count);
+  static const char* phaseName(Phase);
+
+  /// Whole frame CPU time, in microseconds.
+  uint64 frameTime;
+  /// Time spent in each Phase, in microseconds.
+  uint64 phaseTime[PhaseCount];
+
+  /// Chunks registered with the world renderer.
+  uint chunksConsidered;
+  /// Chunks rejected by frustum or occlusion culling.
+  uint chunksCulled;
+  /// Chunks with geometry in at least one draw call.
+  uint chunksDrawn;
+  constexpr static uint LodLevels = 4;
+  /// Drawn chunks by the level of detail their mesh was built at.
+  uint lodChunksDrawn[LodLevels];
+  uint drawCalls;
+  uint64 triangles;
+  uint meshesRebuilt;
+  /// Mesh data sent to the renderer, in bytes.
+  uint64 bytesUploaded;
+
+  void reset();
+};
+
+///
+/// @brief Keeps the FrameStats of the last HistorySize frames.
+///
+class FrameProfiler {
+public:
+  using Clock = std::chrono::steady_clock;
+  constexpr static uint HistorySize = 256;
+
+  ///
+  /// @brief Adds the time spent between construction and destruction to a Phase.
+  ///
+  class Scope {
+    FrameStats &m_stats;
+    FrameStats::Phase m_phase;
+    Clock::time_point m_start;
+
+  public:
+    Scope(FrameStats &stats, FrameStats::Phase phase) :
+      m_stats(stats),
+      m_phase(phase),
+      m_start(Clock::now()) {
+    }
+    nocopy(Scope);
+    ~Scope();
+  };
+
+private:
+  std::array<FrameStats, HistorySize> m_frames;
+  uint m_head, m_count;
+  Clock::time_point m_frameStart;
+
+public:
+  FrameProfiler();
+  nocopy(FrameProfiler);
+
+  ///
+  /// @brief Starts recording a new frame, making it current().
+  ///
+  void beginFrame();
+  ///
+  /// @brief Stops recording current() and commits it to the history.
+  ///
+  void endFrame();
+
+  /// Frame being recorded.
+  FrameStats& current() {
+    return m_frames[m_head];
+  }
+
+  /// Number of completed frames in the history.
+  uint size() const {
+    return m_count;
+  }
+
+  ///
+  /// @returns Completed frame, 0 being the oldest and size() - 1 the latest.
+  ///
+  const FrameStats& operator[](uint i) const {
+    return m_frames[(m_head + HistorySize - m_count + i) % HistorySize];
+  }
+
+  ///
+  /// @returns Average of every field over the last `count` completed frames.
+  ///
+  FrameStats average(uint count) const;
+
+  /// Writes the history as CSV, one line per frame, oldest first, with a header line.
+  void writeCSV(std::ostream&) const;
+  /// Writes the history as a JSON array of objects, oldest first.
+  void writeJSON(std::ostream&) const;
+};
+
+}
+
+#endif /* DIGGLER_FRAME_PROFILER_HPP */
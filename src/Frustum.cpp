@@ -67,4 +67,16 @@ bool Frustum::sphereInFrustum(const vec3 &p, vec3vt radius) const {
   return true;
 }
 
+bool Frustum::boxInFrustum(const AABB<> &b) const {
+  for(int i=0; i < 6; i++) {
+    // Corner furthest along the plane's normal
+    const vec3 &n = pl[i].normal;
+    const vec3 p(n.x >= 0 ? b.max.x : b.min.x, n.y >= 0 ? b.max.y : b.min.y,
+      n.z >= 0 ? b.max.z : b.min.z);
+    if (pl[i].distance(p) < static_cast<vec3vt>(0))
+      return false;
+  }
+  return true;
+}
+
 }
@@ -3,6 +3,7 @@
 
 #include <glm/geometric.hpp>
 
+#include "AABB.hpp"
 #include "platform/types/vec3.hpp"
 
 namespace Diggler {
@@ -56,7 +57,7 @@ public:
   void setCamDef(const vec3 &p, const vec3 &l, const vec3 &u);
   bool pointInFrustum(const vec3 &p) const;
   bool sphereInFrustum(const vec3 &p, vec3vt radius) const;
-  //bool boxInFrustum(const AABB &b) const;
+  bool boxInFrustum(const AABB<> &b) const;
 };
 
 }
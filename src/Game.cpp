@@ -4,16 +4,28 @@
 #include "content/AssetManager.hpp"
 #include "content/ModManager.hpp"
 #include "content/Registry.hpp"
+#include "FrameProfiler.hpp"
 #include "GlobalProperties.hpp"
 #include "KeyBinds.hpp"
 #include "LocalPlayer.hpp"
 #include "render/gl/ProgramManager.hpp"
 #include "render/gl/Renderer.hpp"
+#if defined(DIGGLER_ENABLE_NULL_RENDERER)
+  #include "render/null/Renderer.hpp"
+#endif
+#include "render/WorldRenderer.hpp"
 #include "scripting/lua/State.hpp"
 #include "ui/FontManager.hpp"
+#include "util/JobPool.hpp"
+#include "util/Log.hpp"
 
 namespace Diggler {
 
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "Game";
+
 Game::Game() :
   C(nullptr),
   U(nullptr),
@@ -35,6 +47,7 @@ Game::Game() :
 }
 
 void Game::init() {
+  JP = std::make_unique<Util::JobPool>();
   AM = std::make_unique<Content::AssetManager>(this);
   MM = std::make_unique<Content::ModManager>(this);
   LS = new Scripting::Lua::State(this);
@@ -52,10 +65,27 @@ void Game::initClient() {
   RP = new RenderProperties; { // TODO move somewhere else?
     RP->bloom = true;
     RP->wavingLiquids = !true;
-    RP->fogStart = 16;
-    RP->fogEnd = 24;
+    RP->fogStart = 48;
+    RP->fogEnd = 60;
+    RP->viewDistance = 64;
+    RP->lodDistance = 16;
+    RP->sharedChunkBuffers = true;
+    RP->occlusionCulling = true;
+    RP->chunkRebuildBudget = 4;
+    RP->chunkUploadBudget = 4 << 20;
+  }
+  FP = std::make_unique<FrameProfiler>();
+  R = nullptr;
+#if defined(DIGGLER_ENABLE_NULL_RENDERER)
+  if (GlobalProperties::IsHeadless)
+    R = new Render::null::NullRenderer(this);
+#endif
+  if (!R)
+    R = new Render::gl::GLRenderer(this);
+  if (Render::WorldRenderer::selectLod(RP->viewDistance, RP->lodDistance) == 0) {
+    Log(Warning, TAG) << "LOD distance " << RP->lodDistance << " is beyond the view distance " <<
+      RP->viewDistance << ", chunks will only be drawn at full resolution";
   }
-  R = new Render::gl::GLRenderer(this);
   CR = new Content::Registry(*this);
   FM = std::make_unique<UI::FontManager>(*this);
   A = new Audio(*this);
@@ -79,6 +109,7 @@ void Game::finalize() {
   MM.reset();
   AM.reset();
   delete CR; CR = nullptr;
+  JP.reset();
 }
 
 void Game::finalizeClient() {
@@ -87,6 +118,7 @@ void Game::finalizeClient() {
   delete A; A = nullptr;
   FM.reset();
   delete R; R = nullptr;
+  FP.reset();
   delete RP; RP = nullptr;
   delete PM; PM = nullptr;
 }
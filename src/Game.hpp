@@ -34,8 +34,13 @@ class FontManager;
 class Manager;
 }
 
+namespace Util {
+class JobPool;
+}
+
 class Audio;
 class Config;
+class FrameProfiler;
 class GameWindow;
 class KeyBinds;
 class LocalPlayer;
@@ -57,6 +62,7 @@ public:
   ptr<Content::AssetManager> AM;
   ptr<Content::ModManager> MM;
   Scripting::Lua::State *LS;
+  ptr<Util::JobPool> JP;
 
   // Server
   Server *S;
@@ -68,9 +74,15 @@ public:
   Render::gl::ProgramManager *PM;
   Render::Renderer *R;
   ptr<UI::FontManager> FM;
+  ptr<FrameProfiler> FP;
   struct RenderProperties {
     bool bloom, wavingLiquids;
     float fogStart, fogEnd;
+    float viewDistance; // Camera far plane
+    float lodDistance;
+    bool sharedChunkBuffers, occlusionCulling;
+    float chunkRebuildBudget; // Milliseconds per frame
+    uint chunkUploadBudget; // Bytes per frame
   } *RP;
   Audio *A;
   Net::Peer *NS;
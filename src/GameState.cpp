@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <memory>
 #include <sstream>
@@ -18,6 +19,7 @@
 #include "content/Registry.hpp"
 #include "content/texture/TextureLoader.hpp"
 #include "EscMenu.hpp"
+#include "FrameProfiler.hpp"
 #include "Game.hpp"
 #include "GlobalProperties.hpp"
 #include "KeyBinds.hpp"
@@ -27,6 +29,7 @@
 #include "network/msgtypes/PlayerUpdate.hpp"
 #include "network/NetHelper.hpp"
 #include "Particles.hpp"
+#include "Platform.hpp"
 #include "render/gl/FBO.hpp"
 #include "render/gl/ProgramManager.hpp"
 #include "render/Renderer.hpp"
@@ -34,15 +37,29 @@
 #include "Skybox.hpp"
 #include "ui/FontManager.hpp"
 #include "ui/Manager.hpp"
+#include "util/Log.hpp"
 
 using std::unique_ptr;
 
 namespace Diggler {
 
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "GameState";
+
+// Room for a few seconds' worth of messages; the network thread keeps any excess received
+constexpr static size_t NetworkQueueSize = 4096;
+// How long the network thread waits on the socket, bounding the delay of outgoing messages
+constexpr static Net::Host::Timeout NetworkThreadTimeout = 1;
+
 GameState::GameState(GameWindow *GW) :
   GW(GW),
   CMH(*this),
-  bloom(*GW->G) {
+  bloom(*GW->G),
+  m_networkThreadRun(false),
+  m_received(NetworkQueueSize),
+  m_toSend(NetworkQueueSize) {
   G = GW->G;
   int w = GW->getW(),
       h = GW->getH();
@@ -50,6 +67,21 @@ GameState::GameState(GameWindow *GW) :
   // Initialized in setupUI
   m_chatBox = nullptr;
 
+  debugInfo.show = false;
+  profiler.show = false;
+
+  m_mouseLocked = false;
+  nextNetUpdate = 0;
+
+  if (GW->isHeadless()) {
+    // Nothing gets drawn, but the world renderer still culls against the camera's frustum
+    m_3dFbo = nullptr;
+    m_3dRenderVBO = nullptr;
+    m_clouds = nullptr;
+    G->LP->camera.setPersp((float)M_PI/180*75.0f, (float)w / h, 0.1f, G->RP->viewDistance);
+    return;
+  }
+
   float coords[6*3*2*3] = {
     -1.0f,-1.0f,-1.0f,
     -1.0f,-1.0f, 1.0f,
@@ -93,13 +125,14 @@ GameState::GameState(GameWindow *GW) :
     -1.0f, 1.0f, 1.0f,
     1.0f,-1.0f, 1.0f, 
   };
-  m_highlightBox.vbo.setData(coords, 6*3*2*3);
-  m_highlightBox.program = G->PM->getProgram("3d");
-  m_highlightBox.att_coord = m_highlightBox.program->att("coord");
-  m_highlightBox.uni_unicolor = m_highlightBox.program->uni("unicolor");
-  m_highlightBox.uni_mvp = m_highlightBox.program->uni("mvp");
-  { Render::gl::VAO::Config cfg = m_highlightBox.vao.configure();
-    cfg.vertexAttrib(m_highlightBox.vbo, m_highlightBox.att_coord, 3, GL_FLOAT, 0);
+  m_highlightBox = std::make_unique<HighlightBox>();
+  m_highlightBox->vbo.setData(coords, 6*3*2*3);
+  m_highlightBox->program = G->PM->getProgram("3d");
+  m_highlightBox->att_coord = m_highlightBox->program->att("coord");
+  m_highlightBox->uni_unicolor = m_highlightBox->program->uni("unicolor");
+  m_highlightBox->uni_mvp = m_highlightBox->program->uni("mvp");
+  { Render::gl::VAO::Config cfg = m_highlightBox->vao.configure();
+    cfg.vertexAttrib(m_highlightBox->vbo, m_highlightBox->att_coord, 3, GL_FLOAT, 0);
     cfg.commit();
   }
 
@@ -128,16 +161,15 @@ GameState::GameState(GameWindow *GW) :
       getAssetPath("crosshair.png"), PixelFormat::RGBA)->texture;
 
   //"\f0H\f1e\f2l\f3l\f4l\f5o \f6d\f7e\f8m\f9b\faa\fbz\fcz\fde\fes\ff,\n\f0ye see,it werks purrfektly :D\n(and also; it's optimized)"
-
-  debugInfo.show = false;
-
-  m_mouseLocked = false;
-  nextNetUpdate = 0;
 }
 
 GameState::Bloom::Bloom(Game &G) {
-  enable = true;
+  enable = !G.GW->isHeadless();
   scale = 4;
+  if (!enable) {
+    extractor.fbo = renderer.fbo = nullptr;
+    return;
+  }
 
   extractor.fbo = new Render::gl::FBO(G.GW->getW()/scale, G.GW->getH()/scale, PixelFormat::RGBA);
   extractor.fbo->tex->setFiltering(Texture::Filter::Linear, Texture::Filter::Linear);
@@ -171,6 +203,10 @@ void GameState::setupUI() {
   UI.DebugInfo->setUpdateFrequencyHint(Render::FontRendererTextBufferUsage::Stream);
   UI.DebugInfo->setVisible(false);
 
+  UI.Profiler = G->UIM->add<UI::Text>();
+  UI.Profiler->setUpdateFrequencyHint(Render::FontRendererTextBufferUsage::Stream);
+  UI.Profiler->setVisible(false);
+
   UI.EM = G->UIM->add<EscMenu>();
   UI.EM->setVisible(false);
 
@@ -180,6 +216,7 @@ void GameState::setupUI() {
 }
 
 GameState::~GameState() {
+  stopNetworkThread();
   delete m_clouds;
   delete m_chatBox;
   //delete m_sky;
@@ -202,12 +239,22 @@ void GameState::onKey(int key, int scancode, int action, int mods) {
   switch (key) {
   case GLFW_KEY_ESCAPE:
     if (mods & GLFW_MOD_SHIFT)
-      glfwSetWindowShouldClose(*G->GW, true);
+      GW->setShouldClose(true);
     break;
   case GLFW_KEY_F1:
     if (action == GLFW_PRESS)
       bloom.enable = !bloom.enable;
     break;
+  case GLFW_KEY_F3:
+    if (action == GLFW_PRESS) {
+      if (mods & GLFW_MOD_SHIFT) {
+        dumpFrameStats();
+      } else {
+        profiler.show = !profiler.show;
+        UI.Profiler->setVisible(profiler.show);
+      }
+    }
+    break;
   case GLFW_KEY_F5:
     if (action == GLFW_PRESS) {
       debugInfo.show = !debugInfo.show;
@@ -246,7 +293,9 @@ void GameState::onKey(int key, int scancode, int action, int mods) {
       if (action == GLFW_PRESS) {
         std::string str = m_chatBox->getChatString();
         if (str.size() > 0) {
-          NetHelper::SendChat(G, str);
+          Net::OutMessage msg;
+          NetHelper::MakeChat(msg, str);
+          sendMsg(msg, Net::Tfer::Unseq);
         }
         m_chatBox->setIsChatting(false);
       }
@@ -384,7 +433,7 @@ void GameState::onMouseScroll(double x, double y) {
 void GameState::updateViewport() {
   int w = GW->getW(), h = GW->getH();
   UI::Manager &UIM = *G->UIM;
-  G->LP->camera.setPersp((float)M_PI/180*75.0f, (float)w / h, 0.1f, 32.0f);
+  G->LP->camera.setPersp((float)M_PI/180*75.0f, (float)w / h, 0.1f, G->RP->viewDistance);
   m_3dFbo->resize(w, h);
   bloom.extractor.fbo->resize(w/bloom.scale, h/bloom.scale);
   //bloom.extractor.fbo->tex->setFiltering(Texture::Filter::Linear, Texture::Filter::Linear);
@@ -408,12 +457,81 @@ void GameState::updateViewport() {
   updateUI();
 }
 
-void GameState::sendMsg(Net::OutMessage &msg, Net::Tfer mode, Net::Channels chan) {
-  G->H.send(*G->NS, msg, mode, chan);
+void GameState::sendMsg(Net::OutMessage &msg, Net::Tfer mode, Net::Channels chan,
+  Net::Flush flush) {
+  // The network thread owns the host, hand it a copy
+  OutgoingMessage out { std::unique_ptr<Net::OutMessage>(
+    new Net::OutMessage(msg.getType(), msg.getSubtype())), mode, chan, flush };
+  if (msg.length() > 0) {
+    out.msg->writeData(msg.data(), msg.length());
+  }
+  while (!m_toSend.push(out)) {
+    std::this_thread::yield();
+  }
+}
+
+void GameState::networkThread() {
+  // Received messages the game thread has no room for yet. Kept here rather than left in the
+  // host, so that it still gets serviced while the game thread stalls.
+  std::deque<std::unique_ptr<Net::ReceivedMessage>> backlog;
+  std::unique_ptr<Net::ReceivedMessage> rm;
+  OutgoingMessage out;
+  bool run = true, connected = true;
+  while (run) {
+    // Whatever was queued before the stop request still goes out
+    run = m_networkThreadRun.load(std::memory_order_acquire);
+    while (m_toSend.pop(out)) {
+      if (connected) {
+        G->H.send(*G->NS, *out.msg, out.mode, out.chan, out.flush);
+      }
+    }
+    out.msg.reset();
+    while (!backlog.empty() && m_received.push(backlog.front())) {
+      backlog.pop_front();
+    }
+    if (!run) {
+      if (connected) {
+        G->H.flush();
+      }
+      break;
+    }
+    if (!connected) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(NetworkThreadTimeout));
+      continue;
+    }
+
+    if (!rm) {
+      rm.reset(new Net::ReceivedMessage);
+    }
+    try {
+      if (!G->H.recv(rm->msg, NetworkThreadTimeout)) {
+        continue;
+      }
+      rm->chunks.clear();
+      Net::ClientMessageHandler::decode(*rm);
+    } catch (const std::exception &e) {
+      Log(Error, TAG) << "Dropped malformed message: " << e.what();
+      continue;
+    }
+    // The peer is deleted by the next recv() after it disconnected
+    connected = rm->msg.getType() != Net::MessageType::NetDisconnect;
+    if (!backlog.empty() || !m_received.push(rm)) {
+      backlog.emplace_back(std::move(rm));
+    }
+  }
+}
+
+void GameState::stopNetworkThread() {
+  if (m_networkThread.joinable()) {
+    m_networkThreadRun.store(false, std::memory_order_release);
+    m_networkThread.join();
+  }
 }
 
 void GameState::run() {
-  setupUI();
+  if (!GW->isHeadless()) {
+    setupUI();
+  }
   gameLoop();
 }
 
@@ -430,23 +548,36 @@ void GameState::gameLoop() {
   G->A->update();
   LP->setHasNoclip(true);
 
-  std::chrono::time_point<std::chrono::steady_clock> frameStart, frameEnd;
+  m_networkThreadRun.store(true, std::memory_order_release);
+  m_networkThread = std::thread(&GameState::networkThread, this);
+
+  FrameProfiler &FP = *G->FP;
+  using Phase = FrameStats::Phase;
+  const bool headless = GW->isHeadless();
   while (!GW->shouldClose()) {
-    if (!processNetwork()) return;
+    FP.beginFrame();
+    { FrameProfiler::Scope scope(FP.current(), Phase::Network);
+      if (!processNetwork()) {
+        stopNetworkThread();
+        return;
+      }
+    }
 
-    T = glfwGetTime(); deltaT = T - lastT;
+    T = GW->getTime(); deltaT = T - lastT;
     G->updateTime(T);
     if (T > fpsT) {
-      char str[10]; std::snprintf(str, 10, "FPS: %-4d", frames);
-      UI.FPS->setText(std::string(str));
+      if (!headless) {
+        char str[10]; std::snprintf(str, 10, "FPS: %-4d", frames);
+        UI.FPS->setText(std::string(str));
+      }
       fpsT = T+1;
       frames = 0;
     }
 
     G->R->beginFrame();
-    frameStart = std::chrono::steady_clock::now();
 
     if (T > nextNetUpdate) {
+      FrameProfiler::Scope scope(FP.current(), Phase::Network);
       Net::MsgTypes::PlayerUpdateMove pum;
       pum.position = LP->position;
       if (LP->velocity != glm::vec3()) {
@@ -454,6 +585,9 @@ void GameState::gameLoop() {
         pum.accel = LP->accel;
       }
       pum.angle = LP->angle;
+      if (snapshotClock.valid) {
+        pum.ackTick = snapshotClock.tick;
+      }
       Net::OutMessage msg; pum.writeToMsg(msg);
       sendMsg(msg, Net::Tfer::Unrel, Net::Channels::Movement);
       nextNetUpdate = T+1.0/G->PlayerPosUpdateFreq;
@@ -465,7 +599,18 @@ void GameState::gameLoop() {
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
 
-    LP->update(deltaT);
+    { FrameProfiler::Scope scope(FP.current(), Phase::Physics);
+      LP->update(deltaT);
+      for (Player &p : G->players) {
+        p.update(deltaT);
+      }
+      if (snapshotClock.valid) {
+        const double renderTick = snapshotClock.renderTick(T);
+        for (Player &p : G->players) {
+          p.interpolate(renderTick, snapshotClock.tickInterval);
+        }
+      }
+    }
 
     glm::mat4 m_transform = LP->getPVMatrix();
 
@@ -476,20 +621,24 @@ void GameState::gameLoop() {
     /*glm::mat4 cloudmat = glm::scale(glm::translate(m_transform, glm::vec3(0.f, W.cloudsHeight, 0.f)), glm::vec3(4*CX, 1, 4*CZ));
     m_clouds->render(cloudmat);*/
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    if (!headless) {
+      glEnable(GL_DEPTH_TEST);
+      glEnable(GL_CULL_FACE);
+    }
 
     Render::RenderParams rp;
     rp.world = WR.get();
     rp.transform = m_transform;
     rp.frustum = G->LP->camera.frustum;
+    rp.cameraPos = glm::vec3(G->LP->camera.getPosition());
     G->R->renderers.world->render(rp);
-    for (Player &p : G->players) {
-      p.update(deltaT);
-      if (G->LP->camera.frustum.sphereInFrustum(p.position, 2))
-        p.render(m_transform);
+    if (!headless) {
+      for (Player &p : G->players) {
+        if (G->LP->camera.frustum.sphereInFrustum(p.position, 2))
+          p.render(m_transform);
+      }
     }
-    //W.renderTransparent(m_transform);
+    G->R->renderers.world->renderTransparent(rp);
 
     /*static ParticleEmitter pe(G);
     pe.posAmpl = glm::vec3(1, 1, 1);
@@ -511,17 +660,26 @@ void GameState::gameLoop() {
     rp.transform = m_transform;
     G->R->PR->render(rp);*/
 
+    if (headless) {
+      G->R->endFrame();
+      FP.endFrame();
+      GW->present();
+      lastT = T;
+      frames++;
+      continue;
+    }
+
     // TODO: replace harcoded 32 viewdistance
     if (G->LP->raytracePointed(32, &m_pointedBlock, &m_pointedFacing)) {
-      m_highlightBox.program->bind();
-      m_highlightBox.vao.bind();
+      m_highlightBox->program->bind();
+      m_highlightBox->vao.bind();
 
-      glUniform4f(m_highlightBox.uni_unicolor, 1.f, 1.f, 1.f, .1f);
-      glUniformMatrix4fv(m_highlightBox.uni_mvp, 1, GL_FALSE, glm::value_ptr(
+      glUniform4f(m_highlightBox->uni_unicolor, 1.f, 1.f, 1.f, .1f);
+      glUniformMatrix4fv(m_highlightBox->uni_mvp, 1, GL_FALSE, glm::value_ptr(
         glm::scale(glm::translate(m_transform, glm::vec3(m_pointedBlock)+glm::vec3(.5f)), glm::vec3(0.5f*1.03f))));
       glDrawArrays(GL_TRIANGLES, 0, 6*2*3);
 
-      m_highlightBox.vao.unbind();
+      m_highlightBox->vao.unbind();
     }
 
     glDisable(GL_CULL_FACE);
@@ -529,6 +687,7 @@ void GameState::gameLoop() {
     LP->render(m_transform);
 
     if (bloom.enable) {
+      FrameProfiler::Scope scope(FP.current(), Phase::Bloom);
       m_3dFbo->unbind();
       G->UIM->drawFullTexV(*m_3dFbo->tex);
 
@@ -572,22 +731,23 @@ void GameState::gameLoop() {
     }
 
     /*** 2D PART ***/
-    G->UIM->drawFullRect(glm::vec4(1.f, 0.f, 0.f, 1-G->LP->health));
-    updateUI();
-    drawUI();
+    { FrameProfiler::Scope scope(FP.current(), Phase::UI);
+      G->UIM->drawFullRect(glm::vec4(1.f, 0.f, 0.f, 1-G->LP->health));
+      updateUI();
+      drawUI();
+    }
 
     G->R->endFrame();
-    frameEnd = std::chrono::steady_clock::now();
-    frameTime = std::chrono::duration_cast<std::chrono::duration<uint64, std::micro>>(frameEnd  - frameStart).count();
+    FP.endFrame();
 
-    glfwSwapBuffers(*GW);
-    glfwPollEvents();
+    GW->present();
 
     lastT = T;
     frames++;
   }
   Net::OutMessage quit(Net::MessageType::PlayerQuit);
-  sendMsg(quit, Net::Tfer::Rel);
+  sendMsg(quit, Net::Tfer::Rel, Net::Channels::Base, Net::Flush::Immediate);
+  stopNetworkThread();
 
   G->LS->finalize();
 }
@@ -600,6 +760,8 @@ void GameState::renderDeathScreen() {
 
 void GameState::updateUI() {
   LocalPlayer &LP = *G->LP;
+  const FrameProfiler &FP = *G->FP;
+  const FrameStats last = FP.average(1);
   if (debugInfo.show) {
     WorldRef w;
     int chunkMem = 0, maxChunkMem = 0;
@@ -621,7 +783,7 @@ void GameState::updateUI() {
       "z: " << LP.position.z << std::endl <<
       "vy: " << LP.velocity.y << std::endl <<
       "r: " << LP.angle << std::endl <<
-      // TODO reintroduce "chunk tris: " << lastVertCount / 3 << std::endl <<
+      "chunk tris: " << last.triangles << std::endl <<
       "chunk mem: " << chunkMem / 1024 << " kib / " << (chunkMem*100/maxChunkMem) << '%' <<
         std::endl <<
       "Pointing at: " << LP.W->getBlockId(m_pointedBlock.x, m_pointedBlock.y, m_pointedBlock.z) <<
@@ -630,9 +792,31 @@ void GameState::updateUI() {
         divrd(m_pointedBlock.z, CZ) << std::endl <<
       "RX: " << G->H.getRxBytes() << std::endl <<
       "TX: " << G->H.getTxBytes() << std::endl <<
-      "Frame time: " << frameTime;
+      "Frame time: " << last.frameTime;
     UI.DebugInfo->setText(oss.str());
   }
+  if (profiler.show) {
+    // Averaged over about a second, as single frames are unreadable at this refresh rate
+    const FrameStats avg = FP.average(60);
+    std::ostringstream oss;
+    oss << "frame: " << avg.frameTime << " us" << std::endl;
+    for (uint p = 0; p < FrameStats::PhaseCount; ++p) {
+      oss << FrameStats::phaseName(static_cast<FrameStats::Phase>(p)) << ": " <<
+        avg.phaseTime[p] << " us" << std::endl;
+    }
+    oss <<
+      "chunks: " << avg.chunksConsidered << " / culled " << avg.chunksCulled << " / drawn " <<
+        avg.chunksDrawn << std::endl <<
+      "by lod: " << avg.lodChunksDrawn[0] << " / " << avg.lodChunksDrawn[1] << " / " <<
+        avg.lodChunksDrawn[2] << " / " << avg.lodChunksDrawn[3] << std::endl <<
+      "draw calls: " << avg.drawCalls << std::endl <<
+      "tris: " << avg.triangles << std::endl <<
+      "rebuilt: " << avg.meshesRebuilt << " / " << avg.bytesUploaded / 1024 << " kib";
+    UI.Profiler->setText(oss.str());
+    const int lineHeight = G->FM->getDefaultFont()->getHeight() * G->UIM->scale;
+    UI.Profiler->setPos(GW->getW() - static_cast<int>(FrameProfiler::HistorySize) * G->UIM->scale,
+      GW->getH() - (lineHeight + UI.Profiler->getSize().y));
+  }
 }
 
 void GameState::drawUI() {
@@ -643,11 +827,73 @@ void GameState::drawUI() {
   // TODO render weapon
 
   G->UIM->drawTex(*G->UIM->PM, UI::Element::Area{0,0,128,128}, *G->CR->getAtlas());
+
+  if (profiler.show) {
+    drawProfilerGraph();
+  }
+}
+
+void GameState::drawProfilerGraph() {
+  const FrameProfiler &FP = *G->FP;
+  // 1 pixel per 0.25 ms before UI scaling, with a marker at 60 FPS; bars are green under the
+  // target frame time, yellow up to twice it, red above
+  constexpr static uint64 UsPerPixel = 250, TargetFrameTime = 1000000 / 60;
+  const int scale = G->UIM->scale,
+    graphW = static_cast<int>(FrameProfiler::HistorySize) * scale,
+    targetH = static_cast<int>(TargetFrameTime / UsPerPixel) * scale,
+    x0 = GW->getW() - graphW;
+  const glm::mat4 &PM = *G->UIM->PM;
+  G->UIM->drawRect(PM, UI::Element::Area(x0, 0, graphW, 2 * targetH),
+    glm::vec4(0.f, 0.f, 0.f, .5f));
+  G->UIM->drawRect(PM, UI::Element::Area(x0, targetH, graphW, 1), glm::vec4(1.f, 1.f, 1.f, .5f));
+  const int first = static_cast<int>(FrameProfiler::HistorySize - FP.size());
+  for (uint i = 0; i < FP.size(); ++i) {
+    const uint64 t = FP[i].frameTime;
+    const glm::vec4 color = t > TargetFrameTime * 2 ? glm::vec4(1.f, 0.f, 0.f, .8f) :
+      t > TargetFrameTime ? glm::vec4(1.f, 1.f, 0.f, .8f) : glm::vec4(0.f, 1.f, 0.f, .8f);
+    const int h = std::min(2 * targetH, std::max(1, static_cast<int>(t / UsPerPixel) * scale));
+    G->UIM->drawRect(PM, UI::Element::Area(x0 + (first + int(i)) * scale, 0, scale, h), color);
+  }
+}
+
+void GameState::dumpFrameStats() {
+  const std::string base = getConfigDirectory() + "/framestats";
+  { std::ofstream csv(base + ".csv");
+    G->FP->writeCSV(csv);
+  }
+  { std::ofstream json(base + ".json");
+    G->FP->writeJSON(json);
+  }
+  Log(Info, TAG) << "Frame stats written to " << base << ".{csv,json}";
+}
+
+void GameState::SnapshotClock::onSnapshot(uint32 newTick, double interval, double time) {
+  if (valid && newTick <= tick) {
+    return;
+  }
+  tickInterval = interval;
+  if (!valid) {
+    valid = true;
+    tick = newTick;
+    tickTime = time;
+    return;
+  }
+  // Follow the arrival times slowly to smooth out network jitter, but catch up at once on
+  // large drifts (e.g. after a lag spike)
+  const double expected = tickTime + (newTick - tick) * tickInterval;
+  const double drift = time - expected;
+  tickTime = std::abs(drift) > 2 * tickInterval ? time : expected + drift * 0.1;
+  tick = newTick;
+}
+
+double GameState::SnapshotClock::renderTick(double time) const {
+  return tick + (time - tickTime) / tickInterval - InterpolationDelay;
 }
 
 bool GameState::processNetwork() {
-  while (G->H.recv(m_msg, 0)) {
-    if (!CMH.handleMessage(m_msg)) {
+  std::unique_ptr<Net::ReceivedMessage> rm;
+  while (m_received.pop(rm)) {
+    if (!CMH.handleMessage(*rm)) {
       return false;
     }
   }
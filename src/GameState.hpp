@@ -3,6 +3,9 @@
 
 #include "State.hpp"
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <thread>
 #include <map>
 #include <list>
@@ -17,6 +20,8 @@
 #include "content/Content.hpp"
 #include "network/Network.hpp"
 #include "network/ClientMessageHandler.hpp"
+#include "network/msgtypes/PlayerUpdate.hpp"
+#include "util/SPSCQueue.hpp"
 // TODO strip?
 #include "Chunk.hpp"
 
@@ -80,12 +85,13 @@ private:
     glm::mat4 mat;
   } m_crossHair;
 
-  struct {
+  struct HighlightBox {
     Render::gl::VBO vbo;
     Render::gl::VAO vao;
     const Render::gl::Program *program;
     GLuint att_coord, uni_unicolor, uni_mvp;
-  } m_highlightBox;
+  };
+  std::unique_ptr<HighlightBox> m_highlightBox;
 
   KeyBindings *m_keybinds;
 
@@ -99,23 +105,43 @@ private:
 
   glm::ivec3 m_pointedBlock, m_pointedFacing;
 
+  ///
+  /// @brief Services the connection, so that neither message handling nor frame stalls delay
+  /// it. It alone uses the host while the game loop runs, exchanging messages with the game
+  /// thread through lock-free queues.
+  ///
   std::thread m_networkThread;
+  std::atomic<bool> m_networkThreadRun;
+  struct OutgoingMessage {
+    std::unique_ptr<Net::OutMessage> msg;
+    Net::Tfer mode;
+    Net::Channels chan;
+    Net::Flush flush;
+  };
+  /// Messages received, decoded as far as possible off the game thread.
+  Util::SPSCQueue<std::unique_ptr<Net::ReceivedMessage>> m_received;
+  /// Messages to send.
+  Util::SPSCQueue<OutgoingMessage> m_toSend;
+  void networkThread();
+  void stopNetworkThread();
 
-  Net::InMessage m_msg;
   float nextNetUpdate;
 
   struct {
     bool show;
   } debugInfo;
 
+  struct {
+    bool show;
+  } profiler;
+
   struct {
     std::shared_ptr<UI::Text> FPS;
     std::shared_ptr<UI::Text> DebugInfo;
+    std::shared_ptr<UI::Text> Profiler;
     std::shared_ptr<class EscMenu> EM;
   } UI;
 
-  uint64 frameTime;
-
   void setupUI();
   void lockMouse();
   void unlockMouse();
@@ -124,6 +150,28 @@ public:
   // TODO: REMOVEME!!!
   std::list<ChunkRef> holdChunksInMem;
 
+  ///
+  /// @brief Estimates the server's snapshot tick from the ones received, to interpolate other
+  /// players slightly in the past.
+  ///
+  struct SnapshotClock {
+    /// How far behind the latest snapshot players are shown, in ticks. Leaves room for one
+    /// late or lost snapshot.
+    constexpr static double InterpolationDelay = 1.5;
+
+    bool valid = false;
+    uint32 tick;
+    /// Local time at which `tick` is estimated to have been sent, in seconds.
+    double tickTime;
+    /// Duration of a tick, in seconds.
+    double tickInterval;
+
+    void onSnapshot(uint32 tick, double tickInterval, double time);
+    double renderTick(double time) const;
+  } snapshotClock;
+  /// Last snapshots received, oldest first, that the server may delta-encode against.
+  std::deque<Net::MsgTypes::PlayerUpdateSnapshot> receivedSnapshots;
+
 public:
   GameState(GameWindow *W);
   ~GameState();
@@ -146,9 +194,12 @@ public:
   void renderDeathScreen();
   void updateUI();
   void drawUI();
+  void drawProfilerGraph();
+  void dumpFrameStats();
   bool processNetwork();
 
-  void sendMsg(Net::OutMessage &msg, Net::Tfer mode, Net::Channels chan = Net::Channels::Base);
+  void sendMsg(Net::OutMessage &msg, Net::Tfer mode, Net::Channels chan = Net::Channels::Base,
+    Net::Flush flush = Net::Flush::Deferred);
 };
 
 }
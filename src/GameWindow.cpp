@@ -1,6 +1,9 @@
 #include "GameWindow.hpp"
 
+#include <atomic>
+#include <csignal>
 #include <sstream>
+#include <thread>
 
 #include <al.h>
 #include <glm/detail/setup.hpp>
@@ -27,11 +30,37 @@ static const char *TAG = "GameWindow";
 
 int GameWindow::InstanceCount = 0;
 
+// Headless windows' close request, set by SIGINT/SIGTERM as there is no window to close
+static std::atomic<bool> HeadlessShouldClose(false);
+// Headless windows run the frame loop at this rate
+constexpr static int HeadlessFrameRate = 60;
+
 static void glfwErrorCallback(int error, const char *description) {
   Log(Error, TAG) << "GLFW Error " << error << ": " << description;
 }
 
-GameWindow::GameWindow(Game *G) : G(G) {
+static void headlessSignalHandler(int) {
+  HeadlessShouldClose.store(true);
+}
+
+GameWindow::GameWindow(Game *G) :
+  m_window(nullptr),
+  m_w(640),
+  m_h(480),
+  m_startTime(std::chrono::steady_clock::now()),
+  m_nextFrame(m_startTime),
+  UIM(nullptr),
+  G(G) {
+  if (GlobalProperties::IsHeadless) {
+    ++InstanceCount;
+    std::signal(SIGINT, headlessSignalHandler);
+    std::signal(SIGTERM, headlessSignalHandler);
+    Log(Info, TAG) << "Running headless";
+    G->init();
+    G->GW = this;
+    return;
+  }
+
   if (InstanceCount++ == 0) {
     glfwSetErrorCallback(glfwErrorCallback);
     int glfwStatus = glfwInit();
@@ -46,8 +75,6 @@ GameWindow::GameWindow(Game *G) : G(G) {
 
   GLFWHandler::getInstance().setWindow(this, m_window);
 
-  m_w = 640; m_h = 480;
-
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
   glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API /*GLFW_OPENGL_ES_API*/);
@@ -146,6 +173,11 @@ GameWindow::~GameWindow() {
   m_nextState.reset();
   delete UIM;
 
+  if (isHeadless()) {
+    --InstanceCount;
+    return;
+  }
+
   glfwDestroyWindow(m_window);
   
   if (--InstanceCount == 0) {
@@ -153,16 +185,55 @@ GameWindow::~GameWindow() {
   }
 }
 
+double GameWindow::getTime() const {
+  if (isHeadless()) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+  }
+  return glfwGetTime();
+}
+
 bool GameWindow::shouldClose() const {
+  if (isHeadless()) {
+    return HeadlessShouldClose.load();
+  }
   return glfwWindowShouldClose(m_window);
 }
 
+void GameWindow::setShouldClose(bool close) {
+  if (isHeadless()) {
+    HeadlessShouldClose.store(close);
+    return;
+  }
+  glfwSetWindowShouldClose(m_window, close);
+}
+
 void GameWindow::setVisible(bool visible) {
+  if (isHeadless()) {
+    return;
+  }
   return visible ? glfwShowWindow(m_window) : glfwHideWindow(m_window);
 }
 
 bool GameWindow::isVisible() const {
-  return glfwGetWindowAttrib(m_window, GLFW_VISIBLE);
+  return !isHeadless() && glfwGetWindowAttrib(m_window, GLFW_VISIBLE);
+}
+
+void GameWindow::present() {
+  if (isHeadless()) {
+    using Clock = std::chrono::steady_clock;
+    m_nextFrame += std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / HeadlessFrameRate));
+    const Clock::time_point now = Clock::now();
+    if (m_nextFrame < now) {
+      // Running late, don't try to catch up
+      m_nextFrame = now;
+    } else {
+      std::this_thread::sleep_until(m_nextFrame);
+    }
+    return;
+  }
+  glfwSwapBuffers(m_window);
+  glfwPollEvents();
 }
 
 void GameWindow::cbChar(char32 unichar) {
@@ -202,7 +273,7 @@ void GameWindow::setNextState(std::unique_ptr<State> &&next) {
 }
 
 void GameWindow::run() {
-  while (m_nextState != nullptr && !glfwWindowShouldClose(m_window)) {
+  while (m_nextState != nullptr && !shouldClose()) {
     m_currentState = std::move(m_nextState);
     m_nextState = nullptr;
     m_currentState->run();
@@ -1,6 +1,7 @@
 #ifndef GAME_WINDOW_HPP
 #define GAME_WINDOW_HPP
 
+#include <chrono>
 #include <memory>
 
 #include <alc.h>
@@ -28,6 +29,8 @@ private:
 
   GLFWwindow *m_window;
   int m_w, m_h;
+  // Headless only: time base and pacing of the frame loop
+  std::chrono::steady_clock::time_point m_startTime, m_nextFrame;
 
   std::unique_ptr<State> m_currentState, m_nextState;
 
@@ -45,7 +48,18 @@ public:
   inline int getW() const { return m_w; }
   inline int getH() const { return m_h; }
 
+  /**
+   * @brief Whether the window was created without a display (GlobalProperties::IsHeadless).
+   * A headless window has no GLFW window nor GL context, and no UI manager: states must not
+   * issue any GL call nor touch `UIM`.
+   */
+  inline bool isHeadless() const { return m_window == nullptr; }
+
+  /// @returns Seconds elapsed since the window was created.
+  double getTime() const;
+
   bool shouldClose() const;
+  void setShouldClose(bool);
 
   void setVisible(bool);
   bool isVisible() const;
@@ -59,6 +73,12 @@ public:
 
   void updateViewport();
 
+  /**
+   * @brief Ends a frame: swaps buffers and processes pending events.
+   * Headless windows instead wait for the next frame slot, as nothing else paces the loop.
+   */
+  void present();
+
   void setNextState(std::unique_ptr<State> &&next);
   void run();
 
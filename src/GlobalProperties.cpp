@@ -4,6 +4,7 @@ namespace Diggler {
 
 bool GlobalProperties::IsClient = true;
 bool GlobalProperties::IsServer = false;
+bool GlobalProperties::IsHeadless = false;
 
 const char *GlobalProperties::DefaultServerHost = "localhost";
 const int   GlobalProperties::DefaultServerPort = 17425;
@@ -6,6 +6,8 @@ namespace Diggler {
 namespace GlobalProperties {
   extern bool IsClient;
   extern bool IsServer;
+  /// Client only: use the null renderer, which needs no GPU or display.
+  extern bool IsHeadless;
 
   extern const char *DefaultServerHost;
   extern const int   DefaultServerPort;
@@ -209,20 +209,23 @@ void LocalPlayer::render(const glm::mat4 &transform) const {
     { max.x, min.y, max.z, 0, 1, 0 },
     { min.x, min.y, max.z, 0, 1, 0 },
   };
-  vbo.setDataGrow(pts, sizeof(pts)/sizeof(Coord), GL_STREAM_DRAW);
+  if (!vbo) {
+    vbo = std::make_unique<Render::gl::VBO>();
+  }
+  vbo->setDataGrow(pts, sizeof(pts)/sizeof(Coord), GL_STREAM_DRAW);
   const Render::gl::Program &P = *G->PM->getProgram("3d", "color0");
-  if (!vaoConfigured) {
-    vaoConfigured = true;
-    Render::gl::VAO::Config cfg = vao.configure();
-    cfg.vertexAttrib(vbo, P.att("coord"), 3, GL_FLOAT, sizeof(Coord), 0);
-    cfg.vertexAttrib(vbo, P.att("color"), 3, GL_UNSIGNED_BYTE, sizeof(Coord), offsetof(Coord, r));
+  if (!vao) {
+    vao = std::make_unique<Render::gl::VAO>();
+    Render::gl::VAO::Config cfg = vao->configure();
+    cfg.vertexAttrib(*vbo, P.att("coord"), 3, GL_FLOAT, sizeof(Coord), 0);
+    cfg.vertexAttrib(*vbo, P.att("color"), 3, GL_UNSIGNED_BYTE, sizeof(Coord), offsetof(Coord, r));
     cfg.commit();
   }
   P.bind();
   glUniformMatrix4fv(P.uni("mvp"), 1, GL_FALSE, glm::value_ptr(transform));
-  vao.bind();
+  vao->bind();
   glDrawArrays(GL_LINES, 0, sizeof(pts)/sizeof(Coord));
-  vao.unbind();
+  vao->unbind();
 }
 
 void LocalPlayer::forceCameraUpdate() {
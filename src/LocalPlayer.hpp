@@ -19,10 +19,9 @@ private:
   bool goingForward, goingBackward, goingLeft, goingRight;
   bool hasGravity, hasNoclip, onGround, onRoad;
 
-  // debugging
-  mutable Render::gl::VBO vbo;
-  mutable Render::gl::VAO vao;
-  mutable bool vaoConfigured = false;
+  // debugging, created on first render so that headless clients never touch GL
+  mutable std::unique_ptr<Render::gl::VBO> vbo;
+  mutable std::unique_ptr<Render::gl::VAO> vao;
 
 public:
   float health;
@@ -9,12 +9,20 @@
 #include "render/Renderer.hpp"
 #include "ui/Manager.hpp"
 #include "ui/Text.hpp"
+#include "util/Log.hpp"
 
 namespace Diggler {
 
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "MessageState";
+
 MessageState::MessageState(GameWindow *W, const std::string &msg, const std::string &submsg)
   : W(W), msg(msg), subMsg(submsg), txtMsg(nullptr), txtSubMsg(nullptr) {
-  glfwSetInputMode(*W, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+  if (!W->isHeadless()) {
+    glfwSetInputMode(*W, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+  }
 }
 
 MessageState::~MessageState() {
@@ -39,11 +47,16 @@ void MessageState::onResize(int w, int h) {
 }
 
 void MessageState::run() {
+  if (W->isHeadless()) {
+    // Nobody to show it to until the window closes, log it and quit instead
+    Log(Info, TAG) << msg << (subMsg.empty() ? "" : ": ") << subMsg;
+    return;
+  }
   setupUI();
   if (GlobalProperties::IsSoundEnabled) {
     W->G->A->playSound("click-quiet");
   }
-  while (!glfwWindowShouldClose(*W)) {
+  while (!W->shouldClose()) {
     W->G->R->beginFrame();
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -52,8 +65,7 @@ void MessageState::run() {
 
     W->G->R->endFrame();
 
-    glfwSwapBuffers(*W);
-    glfwPollEvents();
+    W->present();
   }
 }
 
@@ -1,13 +1,22 @@
 #include "Particles.hpp"
 #include "Platform.hpp"
 
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE__)
+  #include <xmmintrin.h>
+#endif
+
 #include "Game.hpp"
 #include "render/Renderer.hpp"
+#include "util/JobPool.hpp"
 
 namespace Diggler {
 
 ParticleEmitter::ParticleEmitter(Game *G) :
-  G(G) {
+  G(G),
+  maxCount(0) {
   G->R->renderers.particles->registerEmitter(*this);
 }
 
@@ -16,35 +25,149 @@ ParticleEmitter::~ParticleEmitter() {
 }
 
 void ParticleEmitter::setMaxCount(decltype(maxCount) count) {
-  particles.reserve(count);
-  for (decltype(maxCount) i = maxCount; i < count; ++i) {
-    particles[i].decay = -1;
+  // New particles have already decayed, and get spawned on next update
+  for (std::vector<float> *v : { &m_posX, &m_posY, &m_posZ, &m_velX, &m_velY, &m_velZ }) {
+    v->resize(count, 0.f);
   }
+  m_decay.resize(count, -1.f);
+  m_renderData.resize(count);
   maxCount = count;
 }
 
-void ParticleEmitter::emit(Particle &p) {
-  p.pos = this->pos + glm::vec3(posAmpl.x*(FastRandF()*2-1), posAmpl.y*(FastRandF()*2-1), posAmpl.z*(FastRandF()*2-1));
-  p.vel = pTemplate.vel + glm::vec3(velAmpl.x*(FastRandF()*2-1), velAmpl.y*(FastRandF()*2-1), velAmpl.z*(FastRandF()*2-1));
-  p.accel = pTemplate.accel;
-  p.color = pTemplate.color;
-  p.size = pTemplate.size;
-  p.decay = pTemplate.decay + (FastRandF()*2-1)*decayAmpl;
+void ParticleEmitter::respawn(size_t i) {
+  m_posX[i] = pos.x + posAmpl.x*(FastRandF()*2-1);
+  m_posY[i] = pos.y + posAmpl.y*(FastRandF()*2-1);
+  m_posZ[i] = pos.z + posAmpl.z*(FastRandF()*2-1);
+  m_velX[i] = pTemplate.vel.x + velAmpl.x*(FastRandF()*2-1);
+  m_velY[i] = pTemplate.vel.y + velAmpl.y*(FastRandF()*2-1);
+  m_velZ[i] = pTemplate.vel.z + velAmpl.z*(FastRandF()*2-1);
+  m_decay[i] = pTemplate.decay + (FastRandF()*2-1)*decayAmpl;
+}
+
+void ParticleEmitter::updateRange(size_t begin, size_t end, float dt, Bounds &bounds) {
+  const glm::vec3 &a = pTemplate.accel;
+  const glm::vec4 &c = pTemplate.color;
+  float *const px = m_posX.data(), *const py = m_posY.data(), *const pz = m_posZ.data(),
+    *const vx = m_velX.data(), *const vy = m_velY.data(), *const vz = m_velZ.data(),
+    *const decay = m_decay.data();
+  ParticleRenderData *const rd = m_renderData.data();
+  size_t i = begin;
+#if defined(__SSE__)
+  {
+    const __m128 dtv = _mm_set1_ps(dt), zero = _mm_setzero_ps(),
+      dvx = _mm_set1_ps(a.x * dt), dvy = _mm_set1_ps(a.y * dt), dvz = _mm_set1_ps(a.z * dt),
+      // Second half of each particle's render data, identical for all of them
+      gbas = _mm_setr_ps(c.g, c.b, c.a, pTemplate.size), r = _mm_set1_ps(c.r);
+    __m128 minX = _mm_set1_ps(bounds.min[0]), minY = _mm_set1_ps(bounds.min[1]),
+      minZ = _mm_set1_ps(bounds.min[2]), maxX = _mm_set1_ps(bounds.max[0]),
+      maxY = _mm_set1_ps(bounds.max[1]), maxZ = _mm_set1_ps(bounds.max[2]);
+    for (; i + 4 <= end; i += 4) {
+      const __m128 nvx = _mm_add_ps(_mm_loadu_ps(vx + i), dvx),
+        nvy = _mm_add_ps(_mm_loadu_ps(vy + i), dvy),
+        nvz = _mm_add_ps(_mm_loadu_ps(vz + i), dvz);
+      _mm_storeu_ps(vx + i, nvx);
+      _mm_storeu_ps(vy + i, nvy);
+      _mm_storeu_ps(vz + i, nvz);
+      __m128 x = _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(nvx, dtv)),
+        y = _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(nvy, dtv)),
+        z = _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(nvz, dtv));
+      _mm_storeu_ps(px + i, x);
+      _mm_storeu_ps(py + i, y);
+      _mm_storeu_ps(pz + i, z);
+      const __m128 d = _mm_sub_ps(_mm_loadu_ps(decay + i), dtv);
+      _mm_storeu_ps(decay + i, d);
+      if (const int dead = _mm_movemask_ps(_mm_cmplt_ps(d, zero))) {
+        for (int l = 0; l < 4; ++l) {
+          if (dead & (1 << l))
+            respawn(i + l);
+        }
+        x = _mm_loadu_ps(px + i);
+        y = _mm_loadu_ps(py + i);
+        z = _mm_loadu_ps(pz + i);
+      }
+      minX = _mm_min_ps(minX, x);
+      minY = _mm_min_ps(minY, y);
+      minZ = _mm_min_ps(minZ, z);
+      maxX = _mm_max_ps(maxX, x);
+      maxY = _mm_max_ps(maxY, y);
+      maxZ = _mm_max_ps(maxZ, z);
+      // Rows become each particle's x, y, z, r
+      __m128 p0 = x, p1 = y, p2 = z, p3 = r;
+      _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+      _mm_storeu_ps(&rd[i].x, p0);
+      _mm_storeu_ps(&rd[i].g, gbas);
+      _mm_storeu_ps(&rd[i + 1].x, p1);
+      _mm_storeu_ps(&rd[i + 1].g, gbas);
+      _mm_storeu_ps(&rd[i + 2].x, p2);
+      _mm_storeu_ps(&rd[i + 2].g, gbas);
+      _mm_storeu_ps(&rd[i + 3].x, p3);
+      _mm_storeu_ps(&rd[i + 3].g, gbas);
+    }
+    float tmp[4];
+    const auto hmin = [&tmp](__m128 v) {
+      _mm_storeu_ps(tmp, v);
+      return std::min(std::min(tmp[0], tmp[1]), std::min(tmp[2], tmp[3]));
+    };
+    const auto hmax = [&tmp](__m128 v) {
+      _mm_storeu_ps(tmp, v);
+      return std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3]));
+    };
+    bounds.min[0] = hmin(minX);
+    bounds.min[1] = hmin(minY);
+    bounds.min[2] = hmin(minZ);
+    bounds.max[0] = hmax(maxX);
+    bounds.max[1] = hmax(maxY);
+    bounds.max[2] = hmax(maxZ);
+  }
+#endif
+  for (; i < end; ++i) {
+    vx[i] += a.x * dt;
+    vy[i] += a.y * dt;
+    vz[i] += a.z * dt;
+    px[i] += vx[i] * dt;
+    py[i] += vy[i] * dt;
+    pz[i] += vz[i] * dt;
+    decay[i] -= dt;
+    if (decay[i] < 0)
+      respawn(i);
+    bounds.min[0] = std::min(bounds.min[0], px[i]);
+    bounds.min[1] = std::min(bounds.min[1], py[i]);
+    bounds.min[2] = std::min(bounds.min[2], pz[i]);
+    bounds.max[0] = std::max(bounds.max[0], px[i]);
+    bounds.max[1] = std::max(bounds.max[1], py[i]);
+    bounds.max[2] = std::max(bounds.max[2], pz[i]);
+    rd[i] = { px[i], py[i], pz[i], c.r, c.g, c.b, c.a, pTemplate.size };
+  }
 }
 
 void ParticleEmitter::update(double delta) {
-  std::unique_ptr<ParticleRenderData[]> data(new ParticleRenderData[maxCount]);
-  float deltaF = delta;
-  for (decltype(maxCount) i = 0; i < maxCount; ++i) {
-    Particle &p = particles[i];
-    p.vel += p.accel * deltaF;
-    p.pos += p.vel * deltaF;
-    p.decay -= deltaF;
-    if (p.decay < 0)
-      emit(p);
-    data[i] = { p.pos.x, p.pos.y, p.pos.z, p.color.r, p.color.g, p.color.b, p.color.a, p.size };
+  constexpr float Inf = std::numeric_limits<float>::infinity();
+  const float deltaF = delta;
+  const size_t rangeCount = maxCount >= ParallelThreshold ?
+    (maxCount + ParallelGrain - 1) / ParallelGrain : 1;
+  m_rangeBounds.assign(rangeCount, Bounds { { Inf, Inf, Inf }, { -Inf, -Inf, -Inf } });
+  if (rangeCount > 1) {
+    G->JP->parallelFor(maxCount, ParallelGrain, [this, deltaF](size_t begin, size_t end) {
+      updateRange(begin, end, deltaF, m_rangeBounds[begin / ParallelGrain]);
+    });
+  } else {
+    updateRange(0, maxCount, deltaF, m_rangeBounds[0]);
+  }
+
+  Bounds b = m_rangeBounds[0];
+  for (const Bounds &rb : m_rangeBounds) {
+    for (int c = 0; c < 3; ++c) {
+      b.min[c] = std::min(b.min[c], rb.min[c]);
+      b.max[c] = std::max(b.max[c], rb.max[c]);
+    }
+  }
+  if (maxCount > 0) {
+    // Points are drawn with a size, pad by it
+    const float pad = pTemplate.size;
+    m_bounds.set(vec3(b.min[0] - pad, b.min[1] - pad, b.min[2] - pad),
+      vec3(b.max[0] + pad, b.max[1] + pad, b.max[2] + pad));
   }
-  G->R->renderers.particles->updateParticleData(*this, data.get(), maxCount);
+  G->R->renderers.particles->updateParticleData(*this, m_renderData.data(), maxCount);
 }
 
 }
@@ -7,6 +7,8 @@
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 
+#include "AABB.hpp"
+
 namespace Diggler {
 
 namespace Render {
@@ -21,19 +23,44 @@ struct Particle {
   float size, decay;
 };
 
+///
+/// @brief Keeps a fixed number of particles alive, respawning them around `pos` as they decay.
+/// Particles are stored as a structure of arrays and integrated 4 at a time when SSE is
+/// available; large emitters are split across the Game's JobPool.
+/// Acceleration, color and size are shared by all particles and read from pTemplate.
+///
 class ParticleEmitter {
   friend class Render::ParticlesRenderer;
   uintptr_t rendererData;
 
   Game *G;
 
-  size_t count, maxCount;
-  std::vector<Particle> particles;
+  size_t maxCount;
 public:
   struct ParticleRenderData {
     float x, y, z, r, g, b, a, s;
   };
 
+  /// Emitters with at least this many particles get updated in parallel.
+  constexpr static size_t ParallelThreshold = 16384;
+  /// Particles per parallel job.
+  constexpr static size_t ParallelGrain = 8192;
+
+private:
+  std::vector<float> m_posX, m_posY, m_posZ, m_velX, m_velY, m_velZ, m_decay;
+  // Kept across frames, so that updates don't allocate
+  std::vector<ParticleRenderData> m_renderData;
+  AABB<> m_bounds;
+
+  struct Bounds {
+    float min[3], max[3];
+  };
+  std::vector<Bounds> m_rangeBounds;
+
+  void respawn(size_t i);
+  void updateRange(size_t begin, size_t end, float delta, Bounds &bounds);
+
+public:
   Particle pTemplate;
   glm::vec3 pos;
 
@@ -48,7 +75,13 @@ public:
     return maxCount;
   }
 
-  void emit(Particle&);
+  ///
+  /// @returns Bounds of all particles as of the last update(), for culling.
+  ///
+  const AABB<>& getBounds() const {
+    return m_bounds;
+  }
+
   void update(double delta);
 };
 
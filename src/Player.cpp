@@ -1,5 +1,8 @@
 #include "Player.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include <glm/gtc/matrix_transform.hpp> 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
@@ -20,7 +23,7 @@ Player::Player(Game *G) :
   toolUseTime(0),
   isAlive(true),
   peer(nullptr) {
-  if (GlobalProperties::IsClient) {
+  if (GlobalProperties::IsClient && !GlobalProperties::IsHeadless) {
     if (R.prog == nullptr) {
       R.prog = G->PM->getProgram("3d", "fog0");
       R.att_coord = R.prog->att("coord");
@@ -44,17 +47,57 @@ Player::Player(Game *G) :
   }
 }
 
+// Enough to cover a few lost or late snapshots
+static constexpr size_t MaxSnapshots = 8;
+
 void Player::setPosVel(const glm::vec3 &pos, const glm::vec3 &vel, const glm::vec3 &acc) {
-  lastPosition = m_predictPos;
   position = m_predictPos = pos;
   velocity = vel;
   accel = acc;
-  m_lastPosTime = G->Time;
+  m_snapshots.clear();
 }
 
 void Player::update(const float &delta) {
   velocity += accel * delta;
-  m_predictPos = glm::mix(lastPosition, position, std::min((G->Time-m_lastPosTime)*G->PlayerPosUpdateFreq, 1.0));
+}
+
+void Player::addSnapshot(const Snapshot &snap) {
+  if (!m_snapshots.empty() && snap.tick <= m_snapshots.back().tick) {
+    return;
+  }
+  if (m_snapshots.size() == MaxSnapshots) {
+    m_snapshots.erase(m_snapshots.begin());
+  }
+  m_snapshots.push_back(snap);
+  position = snap.position;
+  velocity = snap.velocity;
+  accel = glm::vec3();
+}
+
+void Player::interpolate(double renderTick, double tickInterval) {
+  if (m_snapshots.empty()) {
+    return;
+  }
+  const Snapshot &first = m_snapshots.front(), &last = m_snapshots.back();
+  if (renderTick <= first.tick) {
+    m_predictPos = first.position;
+    angle = first.angle;
+    return;
+  }
+  if (renderTick >= last.tick) {
+    // Keep going for at most one tick, then wait for the next snapshot
+    const double ahead = std::min(renderTick - last.tick, 1.0) * tickInterval;
+    m_predictPos = last.position + last.velocity * static_cast<float>(ahead);
+    angle = last.angle;
+    return;
+  }
+  const auto next = std::upper_bound(m_snapshots.begin(), m_snapshots.end(), renderTick,
+    [](double tick, const Snapshot &s) { return tick < s.tick; });
+  const Snapshot &a = *(next - 1), &b = *next;
+  const float t = static_cast<float>((renderTick - a.tick) / (b.tick - a.tick));
+  m_predictPos = glm::mix(a.position, b.position, t);
+  // Turn the shortest way around
+  angle = a.angle + static_cast<float>(std::remainder(b.angle - a.angle, 2 * M_PI)) * t;
 }
 
 static inline int getSide(float angle) {
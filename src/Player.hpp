@@ -5,6 +5,7 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <vector>
 
 #include "render/gl/OpenGL.hpp"
 #include <glm/glm.hpp>
@@ -41,7 +42,6 @@ protected:
         uni_fogEnd;
     std::unique_ptr<Render::gl::VBO> vbo;
   } R;
-  double m_lastPosTime;
   glm::vec3 m_predictPos;
 
 public:
@@ -54,7 +54,7 @@ public:
 
   Game *G;
   WorldRef W;
-  glm::vec3 position, lastPosition, velocity, accel;
+  glm::vec3 position, velocity, accel;
   float angle; double toolUseTime;
   std::string name;
   using SessionID = uint32;
@@ -63,12 +63,38 @@ public:
   Net::Peer *peer;
   std::list<ChunkRef> pendingChunks;
 
+  /// State of the player at a server tick, as received in snapshots.
+  struct Snapshot {
+    uint32 tick;
+    glm::vec3 position, velocity;
+    float angle;
+  };
+
+protected:
+  /// Most recent snapshots, oldest first.
+  std::vector<Snapshot> m_snapshots;
+
+public:
   Player(Game *G = nullptr);
   nocopy(Player);
   defaultmove(Player);
 
   void setPosVel(const glm::vec3 &pos, const glm::vec3 &vel, const glm::vec3 &acc = glm::vec3());
   void update(const float &delta);
+
+  ///
+  /// @brief Records the player's state at a server tick. Snapshots older than the latest one,
+  /// received out of order, are dropped.
+  ///
+  void addSnapshot(const Snapshot&);
+
+  ///
+  /// @brief Moves the displayed player to its state at `renderTick`, interpolated between the
+  /// surrounding snapshots.
+  /// @param tickInterval Duration of a tick in seconds, used to extrapolate a little past the
+  /// latest snapshot when the next one is late.
+  ///
+  void interpolate(double renderTick, double tickInterval);
   void render(const glm::mat4 &transform) const;
   void setDead(bool);
 };
@@ -1,9 +1,11 @@
 #include "Server.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <thread>
 #include <sstream>
+#include <unordered_map>
 
 #include <lua.h>
 
@@ -33,6 +35,10 @@ using namespace Util::Logging::LogLevels;
 
 static const char *TAG = "Server";
 
+// Interest management, see Net::InterestManager::Config
+static constexpr int ViewDistance = 4;
+static constexpr float MovementRelevanceRadius = 128, MovementFullRateRadius = 32;
+
 inline Player* Server::getPlayerByPeer(const Peer &peer) {
   return G.players.getByPeer(peer);
 }
@@ -69,6 +75,7 @@ void Server::handlePlayerJoin(InMessage &msg, Peer &peer) {
   plr.sessId = FastRand();
   plr.peer = &peer;
   plr.W = G.U->getLoadWorld(0);
+  IM.update(plr);
 
   /* Confirm successful join */ {
     MsgTypes::PlayerJoinSuccess pjs;
@@ -98,11 +105,7 @@ void Server::handlePlayerJoin(InMessage &msg, Peer &peer) {
     pjb.name = plr.name;
     pjb.wid = plr.W->id;
     OutMessage broadcast; pjb.writeToMsg(broadcast);
-    for (Player &p : G.players) {
-      if (p.sessId == plr.sessId)
-        continue; // don't send broadcast to the player
-      H.send(*p.peer, broadcast, Tfer::Rel);
-    }
+    NetHelper::BroadcastExcept(G, plr, broadcast, Tfer::Rel); // don't send broadcast to the player
   }
 
   Log(Verbose, TAG) << plr.name << " joined from " << peer.peerHost();
@@ -119,12 +122,11 @@ void Server::handlePlayerQuit(Peer &peer, QuitReason reason) {
     // Broadcast disconnection
     OutMessage broadcast(MessageType::PlayerQuit, reason);
     broadcast.writeU32(plr.sessId);
-    for (Player &p : G.players) {
-      if (p.sessId == plr.sessId)
-        continue; // dont send broadcast to the player
-      H.send(*p.peer, broadcast, Tfer::Rel);
-    }
+    NetHelper::BroadcastExcept(G, plr, broadcast, Tfer::Rel); // dont send broadcast to the player
     Log(Verbose, TAG) << plr.name << " disconnected";
+    IM.remove(plr.sessId);
+    m_movedPlayers.erase(plr.sessId);
+    m_sentSnapshots.erase(plr.sessId);
     G.players.remove(plr);
   } else {
     Log(Verbose, TAG) << peer.peerHost() << " disconnected";
@@ -184,15 +186,21 @@ void Server::handlePlayerUpdate(InMessage &msg, Player &plr) {
   case S::Move: {
     PlayerUpdateMove pum;
     pum.readFromMsg(msg);
-    pum.plrSessId = plr.sessId;
-    // Broadcast movement
-    OutMessage bcast; pum.writeToMsg(bcast);
-    for (Player &p : G.players) {
-      if (p.sessId == plr.sessId)
-        continue; // dont send broadcast to the player
-      // TODO: confirm position to player
-      H.send(*p.peer, bcast, Tfer::Unrel);
+    if (pum.position) {
+      plr.position = *pum.position;
+      IM.update(plr);
+    }
+    // Clients leave out velocity and acceleration when standing still
+    plr.velocity = pum.velocity ? *pum.velocity : glm::vec3();
+    plr.accel = pum.accel ? *pum.accel : glm::vec3();
+    plr.angle = pum.angle;
+    if (pum.ackTick) {
+      SentSnapshots &ss = m_sentSnapshots[plr.sessId];
+      ss.ackTick = std::max(ss.ackTick, std::min(*pum.ackTick, m_snapshotTick));
     }
+    // TODO: confirm position to player
+    // Relayed with the next snapshot
+    m_movedPlayers.insert(plr.sessId);
   } break;
   case S::Die:
     handlePlayerDeath(msg, plr);
@@ -202,6 +210,70 @@ void Server::handlePlayerUpdate(InMessage &msg, Player &plr) {
   }
 }
 
+void Server::sendPlayerSnapshots() {
+  using namespace Net::MsgTypes;
+  ++m_snapshotTick;
+  if (m_movedPlayers.empty()) {
+    return;
+  }
+  // Gather each client's relevant players, less often the farther they are
+  std::unordered_map<Peer*, PlayerUpdateSnapshot> snapshots;
+  std::vector<Peer*> peers;
+  for (Player::SessionID sessId : m_movedPlayers) {
+    const Player *plr = getPlayerBySessId(sessId);
+    if (plr == nullptr) {
+      continue;
+    }
+    peers.clear();
+    IM.getMovementRecipients(*plr, peers);
+    for (Peer *peer : peers) {
+      snapshots[peer].players.push_back(PlayerUpdateSnapshot::PlayerState {
+        plr->sessId, plr->position, plr->velocity, plr->angle
+      });
+    }
+  }
+  m_movedPlayers.clear();
+
+  for (auto &pair : snapshots) {
+    PlayerUpdateSnapshot &pus = pair.second;
+    pus.tick = m_snapshotTick;
+    pus.tickInterval = static_cast<uint16>(1000 / G.PlayerPosUpdateFreq);
+    const Player *recipient = getPlayerByPeer(*pair.first);
+    if (recipient == nullptr) {
+      continue;
+    }
+    // Delta-encode against the last snapshot the client got, while we still have it
+    SentSnapshots &ss = m_sentSnapshots[recipient->sessId];
+    for (const PlayerUpdateSnapshot &sent : ss.sent) {
+      if (sent.tick == ss.ackTick && pus.tick - sent.tick <= 0xFF) {
+        pus.baselineTick = sent.tick;
+        pus.baseline = &sent;
+      }
+    }
+    OutMessage msg; pus.writeToMsg(msg);
+    H.send(*pair.first, msg, Tfer::Unrel, Channels::Movement);
+    pus.baselineTick = 0;
+    pus.baseline = nullptr;
+    if (ss.sent.size() == PlayerUpdateSnapshot::BaselineHistory) {
+      ss.sent.pop_front();
+    }
+    ss.sent.emplace_back(std::move(pus));
+  }
+}
+
+void Server::broadcastChunkChanges(Chunk &c) {
+  if (c.CH.empty()) {
+    return;
+  }
+  Net::MsgTypes::BlockUpdateNotify bun;
+  c.CH.flush(bun);
+  OutMessage msg;
+  bun.writeToMsg(msg);
+  std::vector<Peer*> peers;
+  IM.getChunkSubscribers(c.getWorld()->id, c.getWorldChunkPos(), peers);
+  H.broadcast(peers, msg, Tfer::Rel, Channels::MapUpdate);
+}
+
 void Server::schedSendChunk(ChunkRef C, Player &P) {
   P.pendingChunks.emplace_back(C);
 }
@@ -267,13 +339,7 @@ void Server::handlePlayerMapUpdate(InMessage &msg, Player &plr) {
         if (c) {
           c->setBlock(rmod(bup.pos.x, CX), rmod(bup.pos.y, CY), rmod(bup.pos.z, CZ),
                       bup.id, bup.data);
-          if (!c->CH.empty()) {
-            BlockUpdateNotify bun;
-            c->CH.flush(bun);
-            OutMessage omsg;
-            bun.writeToMsg(omsg);
-            NetHelper::Broadcast(G, omsg, Tfer::Rel, Channels::MapUpdate);
-          }
+          broadcastChunkChanges(*c);
         }
       }
     } break;
@@ -286,13 +352,7 @@ void Server::handlePlayerMapUpdate(InMessage &msg, Player &plr) {
         if (c) {
           c->setBlock(rmod(bub.pos.x, CX), rmod(bub.pos.y, CY), rmod(bub.pos.z, CZ),
                       Content::BlockAirId, 0);
-          if (!c->CH.empty()) {
-            BlockUpdateNotify bun;
-            c->CH.flush(bun);
-            OutMessage omsg;
-            bun.writeToMsg(omsg);
-            NetHelper::Broadcast(G, omsg, Tfer::Rel, Channels::MapUpdate);
-          }
+          broadcastChunkChanges(*c);
         }
       }
     } break;
@@ -306,10 +366,7 @@ void Server::handlePlayerDeath(InMessage &msg, Player &plr) {
   pud.plrSessId = plr.sessId;
   plr.setDead(false);
   OutMessage out; pud.writeToMsg(out);
-  for (Player &p : G.players) {
-    if (p.sessId != plr.sessId)
-      H.send(*p.peer, out, Tfer::Rel, Channels::Life);
-  }
+  NetHelper::BroadcastExcept(G, plr, out, Tfer::Rel, Channels::Life);
   
   // Respawn player later
   Game *G = &this->G; Player::SessionID sid = plr.sessId;
@@ -327,7 +384,10 @@ void Server::handlePlayerDeath(InMessage &msg, Player &plr) {
   respawn.detach();
 }
 
-Server::Server(Game &G, uint16 port) : G(G) {
+Server::Server(Game &G, uint16 port) :
+  G(G),
+  IM({ ViewDistance, MovementRelevanceRadius, MovementFullRateRadius }),
+  m_snapshotTick(0) {
   G.init();
 
   Log(Info, TAG) << "Diggler v" << VersionString << " Server, port " << port << ", " <<
@@ -340,6 +400,7 @@ Server::Server(Game &G, uint16 port) : G(G) {
 
   try {
     H.create(port);
+    H.setCoalescing(true);
   } catch (Net::Exception &e) {
     Log(Error, TAG) << "Couldn't open port " << port << " for listening\n" <<
         "Make sure no other server instance is running";
@@ -390,13 +451,8 @@ void Server::chunkUpdater(WorldRef WR, bool &continueUpdate) {
       if ((c = pair.second.lock()))
         c->updateServer();
     for (auto pair : W) {
-      if ((c = pair.second.lock()) && !c->CH.empty()) {
-        // TODO: view range
-        Net::MsgTypes::BlockUpdateNotify bun;
-        c->CH.flush(bun);
-        OutMessage msg;
-        bun.writeToMsg(msg);
-        NetHelper::Broadcast(G, msg, Tfer::Rel, Channels::MapUpdate);
+      if ((c = pair.second.lock())) {
+        broadcastChunkChanges(*c);
       }
     }
     std::list<ChunkRef> chunksToSend;
@@ -421,8 +477,24 @@ void Server::run() {
   bool continueUpdate = true;
   std::thread upd(&Server::chunkUpdater, this, G.U->getWorld(0), std::ref(continueUpdate));
   Player *plr;
+  using Clock = std::chrono::steady_clock;
+  const Clock::duration snapshotInterval =
+    std::chrono::milliseconds(1000 / G.PlayerPosUpdateFreq);
+  Clock::time_point nextSnapshot = Clock::now() + snapshotInterval;
   while (true) {
-    if (H.recv(msg, &peerPtr, 100)) {
+    Clock::time_point now = Clock::now();
+    if (now >= nextSnapshot) {
+      sendPlayerSnapshots();
+      nextSnapshot += snapshotInterval;
+      if (nextSnapshot <= now) {
+        // Fell behind, don't try to catch up
+        nextSnapshot = now + snapshotInterval;
+      }
+    }
+    const Host::Timeout timeout = static_cast<Host::Timeout>(std::min<Clock::rep>(100,
+      std::chrono::duration_cast<std::chrono::milliseconds>(nextSnapshot - now).count()));
+    // Replies are queued, and flushed by recv once all received messages have been handled
+    if (H.recv(msg, &peerPtr, timeout)) {
       Peer &peer = *peerPtr;
       plr = getPlayerByPeer(peer);
       if (plr != nullptr) {
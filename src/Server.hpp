@@ -1,8 +1,13 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
+#include <deque>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "network/InterestManager.hpp"
+#include "network/msgtypes/PlayerUpdate.hpp"
 #include "network/Network.hpp"
 #include "Player.hpp"
 
@@ -19,6 +24,19 @@ private:
   // TODO: REMOVEME!!!
   std::list<ChunkRef> holdChunksInMem;
 
+  Net::InterestManager IM;
+
+  // Players that moved since the last snapshot
+  std::unordered_set<Player::SessionID> m_movedPlayers;
+  uint32 m_snapshotTick;
+  struct SentSnapshots {
+    // Latest snapshot tick the client acknowledged
+    uint32 ackTick = 0;
+    // Last snapshots sent, oldest first, to delta-encode against the acknowledged one
+    std::deque<Net::MsgTypes::PlayerUpdateSnapshot> sent;
+  };
+  std::unordered_map<Player::SessionID, SentSnapshots> m_sentSnapshots;
+
   void handleCommand(Player*, const std::string &command, const std::vector<std::string> &args);
 
   void handlePlayerJoin(Net::InMessage&, Net::Peer&);
@@ -34,6 +52,12 @@ private:
   void handlePlayerChunkRequest(Net::InMessage&, Player&);
   void handlePlayerMapUpdate(Net::InMessage&, Player&);
 
+  // Sends every client the latest state of the relevant players that moved, in one message
+  void sendPlayerSnapshots();
+
+  // Sends the chunk's pending block changes to its subscribers
+  void broadcastChunkChanges(Chunk&);
+
   void schedSendChunk(ChunkRef, Player&);
   void sendChunks(const std::list<ChunkRef>&, Player&);
 
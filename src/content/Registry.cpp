@@ -1,6 +1,9 @@
 #include "Registry.hpp"
 
+#include "../Game.hpp"
 #include "../GlobalProperties.hpp"
+#include "../Universe.hpp"
+#include "../util/JobPool.hpp"
 #include "../util/Log.hpp"
 #include "Content.hpp"
 
@@ -44,6 +47,10 @@ BlockId Registry::BlockRegistration::commit() {
   return it->second->first;
 }
 
+void Registry::BlockRegistration::loadTexture(const std::string &name, const std::string &path) {
+  registry.loadBlockTexture(it->second->first, name, path);
+}
+
 #define NON 0x0
 #define RED 0x1
 #define BLU 0x2
@@ -109,7 +116,10 @@ using Coord = Util::TexturePacker::Coord;
 static Coord unk1, unk2, unk3, unk4, unk5, unk6, unk7, unk8;
 #define AddTex(b, t) Coord b = m_texturePacker->add(getAssetPath("blocks", t));
 Registry::Registry(Game &G) :
+  G(G),
+  m_texturePacker(nullptr),
   m_atlas(nullptr),
+  m_textureBatchDepth(0),
   m_nextMaxBlockId(Content::BlockUnknownId + 1) {
   { Registry::BlockRegistration br(registerBlock(Content::BlockAirId, "air"));
     br.def.appearance.look.type = BlockDef::Appearance::Look::Type::Hidden;
@@ -124,6 +134,9 @@ Registry::Registry(Game &G) :
 
   if (GlobalProperties::IsClient) {
     m_texturePacker = new Util::TexturePacker(G, 64*8, 64*8);
+    m_texturePacker->setResizeCallback([this](int oldWidth, int oldHeight) {
+      rescaleTextureCoords(oldWidth, oldHeight);
+    });
     m_texturePacker->freezeTexUpdate(true);
 
     // Valve checkerboard! :)
@@ -156,6 +169,101 @@ Util::TexturePacker::Coord Registry::addTexture(const std::string &texName,
   return coord;
 }
 
+static void setTextureCoord(BlockDef::Appearance::Texture &tex, const Coord &coord) {
+  tex.coord = coord;
+  tex.divCoords.clear();
+  if (tex.repeat.xdiv > 1 || tex.repeat.ydiv > 1) {
+    uint16 width  = (tex.coord.u - tex.coord.x) / tex.repeat.xdiv,
+           height = (tex.coord.v - tex.coord.y) / tex.repeat.ydiv;
+    for (int16 y = tex.repeat.ydiv - 1; y >= 0; --y) {
+      for (int16 x = tex.repeat.xdiv - 1; x >= 0; --x) {
+        tex.divCoords.emplace_back(Coord {
+          static_cast<uint16>(tex.coord.x + width * x),
+          static_cast<uint16>(tex.coord.y + height * y),
+          static_cast<uint16>(tex.coord.x + width * (x + 1)),
+          static_cast<uint16>(tex.coord.y + height * (y + 1))
+        });
+      }
+    }
+  }
+}
+
+void Registry::loadBlockTexture(BlockId id, const std::string &name, const std::string &path) {
+  if (!m_texturePacker) {
+    return;
+  }
+  if (m_textureBatchDepth > 0) {
+    m_pendingTextures.emplace_back(PendingTexture { id, name, path });
+    return;
+  }
+  setTextureCoord(m_blocks.at(id).appearance.textures.at(name), addTexture(name, path));
+}
+
+void Registry::beginTextureBatch() {
+  ++m_textureBatchDepth;
+}
+
+void Registry::endTextureBatch() {
+  if (m_textureBatchDepth == 0 || --m_textureBatchDepth > 0 || m_pendingTextures.empty()) {
+    return;
+  }
+  std::vector<PendingTexture> pending;
+  pending.swap(m_pendingTextures);
+  std::vector<std::string> paths;
+  paths.reserve(pending.size());
+  for (const PendingTexture &pt : pending) {
+    paths.emplace_back(pt.path);
+  }
+  const std::vector<Coord> coords = m_texturePacker->add(paths, *G.JP);
+  for (std::size_t i = 0; i < pending.size(); ++i) {
+    const PendingTexture &pt = pending[i];
+    m_textureCoords.emplace(pt.name, coords[i]);
+    // The block may have been unregistered in the meantime
+    const BlockIdMap::iterator bit = m_blocks.find(pt.block);
+    if (bit == m_blocks.end()) {
+      continue;
+    }
+    auto tit = bit->second.appearance.textures.find(pt.name);
+    if (tit != bit->second.appearance.textures.end()) {
+      setTextureCoord(tit->second, coords[i]);
+    }
+  }
+}
+
+void Registry::rescaleTextureCoords(int oldAtlasWidth, int oldAtlasHeight) {
+  const Util::TexturePacker &TP = *m_texturePacker;
+  const auto rescale = [&TP, oldAtlasWidth, oldAtlasHeight](Coord &c) {
+    c = TP.rescale(c, oldAtlasWidth, oldAtlasHeight);
+  };
+  for (Coord *unk : { &unk1, &unk2, &unk3, &unk4, &unk5, &unk6, &unk7, &unk8 }) {
+    rescale(*unk);
+  }
+  for (auto &pair : m_textureCoords) {
+    rescale(pair.second);
+  }
+  // Also covers blocks being registered, as their definition already lives in m_blocks
+  for (auto &pair : m_blocks) {
+    for (auto &tex : pair.second.appearance.textures) {
+      rescale(tex.second.coord);
+      for (Coord &c : tex.second.divCoords) {
+        rescale(c);
+      }
+    }
+  }
+  // Meshes already built hold the old coordinates in their vertices
+  if (G.U != nullptr) {
+    for (auto &wpair : *G.U) {
+      if (WorldRef w = wpair.second.lock()) {
+        for (auto &cpair : *w) {
+          if (ChunkRef c = cpair.second.lock()) {
+            c->markAsDirty();
+          }
+        }
+      }
+    }
+  }
+}
+
 const Util::TexturePacker::Coord* Registry::blockTexCoord(BlockId t, FaceDirection d,
   const glm::ivec3 &pos) const {
   if (t == Content::BlockUnknownId) {
@@ -176,7 +284,8 @@ const Util::TexturePacker::Coord* Registry::blockTexCoord(BlockId t, FaceDirecti
     case Type::Cube: {
       const BlockDef::Appearance::Texture &tex =
         bdef.appearance.look.data.cube.sides[static_cast<uint>(d)].texture->second;
-      if (tex.repeat.xdiv == 1 && tex.repeat.ydiv == 1) {
+      // divCoords is empty until a batched texture is loaded
+      if ((tex.repeat.xdiv == 1 && tex.repeat.ydiv == 1) || tex.divCoords.empty()) {
         return &tex.coord;
       }
       size_t idx = 0;
@@ -53,15 +53,29 @@ public:
     BlockRegistration& operator=(BlockRegistration&&) = delete;
 
     BlockId commit();
+
+    ///
+    /// @brief Loads the image at `path` into the block's texture `name`, which must exist.
+    /// Within a texture batch, loading is deferred until the batch ends.
+    ///
+    void loadTexture(const std::string &name, const std::string &path);
   };
 
 private:
   friend class Registration;
 
+  Game &G;
+
   // Client
   Util::TexturePacker *m_texturePacker;
   std::shared_ptr<Texture> m_atlas;
   std::unordered_map<std::string, Util::TexturePacker::Coord> m_textureCoords;
+  struct PendingTexture {
+    BlockId block;
+    std::string name, path;
+  };
+  std::vector<PendingTexture> m_pendingTextures;
+  uint m_textureBatchDepth;
 
   // Shared
   BlockIdMap m_blocks;
@@ -74,6 +88,8 @@ private:
   Registry& operator=(const Registry&) = delete;
 
   BlockRegistration registerBlock(BlockId id, const char *name);
+  void rescaleTextureCoords(int oldAtlasWidth, int oldAtlasHeight);
+  void loadBlockTexture(BlockId, const std::string &name, const std::string &path);
 
 public:
   Registry(Game&);
@@ -84,6 +100,19 @@ public:
   bool canEntityGoThrough(BlockId id/* , Entity& ent*/) const;
 
   Util::TexturePacker::Coord addTexture(const std::string &texName, const std::string &path);
+
+  ///
+  /// @brief Starts collecting block textures instead of loading them one by one.
+  /// Batches nest; the outermost endTextureBatch() loads them all.
+  ///
+  void beginTextureBatch();
+
+  ///
+  /// @brief Decodes the textures collected since beginTextureBatch() in parallel, then packs and
+  /// uploads them at once.
+  ///
+  void endTextureBatch();
+
   const Util::TexturePacker::Coord* blockTexCoord(BlockId, FaceDirection, const glm::ivec3&) const;
   std::shared_ptr<Texture> getAtlas() const {
     return m_atlas;
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <stdexcept>
 
+#include "Varint.hpp"
+
 namespace Diggler {
 namespace IO {
 
@@ -54,6 +56,43 @@ void InMemoryStream::readData(void *data, SizeT len) {
   m_cursor += len;
 }
 
+uint64 InMemoryStream::readVarint(int maxBytes) {
+  // decode8 reads 8 bytes; near the end of the buffer, and for varints over 8 bytes long, fall
+  // back to reading byte by byte
+  if (m_length - m_cursor >= 8) {
+    int len;
+    const uint64 val = Varint::decode8(&m_data[m_cursor], len);
+    if (len != 0) {
+      if (len > maxBytes) {
+        throw std::runtime_error("Varint too long");
+      }
+      m_cursor += len;
+      return val;
+    }
+  }
+  return InStream::readVarint(maxBytes);
+}
+
+void InMemoryStream::readUV32s(uint32 *values, SizeT count) {
+  // Each uv32 is at most 5 bytes, and decode8 may read 3 past that. Check once that there's
+  // enough room for all values at their longest.
+  if (m_length - m_cursor < count * Varint::MaxBytes32 + (8 - Varint::MaxBytes32)) {
+    InStream::readUV32s(values, count);
+    return;
+  }
+  const uint8 *in = &m_data[m_cursor];
+  for (SizeT i = 0; i < count; ++i) {
+    int len;
+    const uint64 val = Varint::decode8(in, len);
+    if (len == 0 || len > Varint::MaxBytes32 || val > UINT32_MAX) {
+      throw std::runtime_error("Invalid uv32");
+    }
+    values[i] = static_cast<uint32>(val);
+    in += len;
+  }
+  m_cursor = static_cast<PosT>(in - m_data);
+}
+
 
 OutMemoryStream::OutMemoryStream(SizeT prealloc) :
   MemoryStream(nullptr, 0),
@@ -43,6 +43,10 @@ public:
   SizeT length() const override;
 
   virtual void readData(void *data, SizeT len) override;
+
+  /// Decodes straight from the buffer, checking bounds once rather than for every byte.
+  virtual uint64 readVarint(int maxBytes) override;
+  virtual void readUV32s(uint32 *values, SizeT count) override;
 };
 
 class OutMemoryStream : public virtual MemoryStream, public virtual OutStream {
@@ -1,7 +1,11 @@
 #include "Stream.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 
+#include "Varint.hpp"
+
 /*
  * Streams are complex things. They exhibit one or a combination of the following properties:
  * - Input / Output / Both
@@ -25,19 +29,25 @@ namespace IO {
 Stream::~Stream() {
 }
 
+// Strings are grown as they're read, in steps of this many characters, so that a bogus length
+// fails on missing data instead of allocating gigabytes upfront.
+constexpr static uint32 StringReadStep = 65536;
+
 void OutStream::writeString(const std::string &str) {
-  if (str.size() > UINT16_MAX)
+  if (str.size() > UINT32_MAX)
     throw std::length_error("String too long");
-  int len = str.size();
-  writeU16(len);
+  uint32 len = str.size();
+  writeUV32(len);
   writeData(str.c_str(), len);
 }
 std::string InStream::readString() {
-  uint16 len = readU16();
-  char *data = new char[len];
-  readData(data, len);
-  std::string str(data, len);
-  delete[] data;
+  uint32 len = readUV32();
+  std::string str;
+  while (str.size() < len) {
+    const size_t offset = str.size();
+    str.resize(offset + std::min(len - offset, static_cast<size_t>(StringReadStep)));
+    readData(&str[offset], str.size() - offset);
+  }
   return str;
 }
 
@@ -49,18 +59,20 @@ bool InStream::readBool() {
 }
 
 void OutStream::writeString32(const std::u32string &str) {
-  if (str.size() > UINT16_MAX)
+  if (str.size() > UINT32_MAX)
     throw std::length_error("String too long");
-  int len = str.size();
-  writeU16(len);
+  uint32 len = str.size();
+  writeUV32(len);
   writeData(str.c_str(), len*sizeof(char32));
 }
 std::u32string InStream::readString32() {
-  uint16 len = readU16();
-  char32 *data = new char32[len];
-  readData(data, len*sizeof(char32));
-  std::u32string str(data, len);
-  delete[] data;
+  uint32 len = readUV32();
+  std::u32string str;
+  while (str.size() < len) {
+    const size_t offset = str.size();
+    str.resize(offset + std::min(len - offset, static_cast<size_t>(StringReadStep)));
+    readData(&str[offset], (str.size() - offset)*sizeof(char32));
+  }
   return str;
 }
 
@@ -154,6 +166,105 @@ double InStream::readDouble() {
   return val;
 }
 
+uint64 InStream::readVarint(int maxBytes) {
+  uint64 val = 0;
+  for (int i = 0; i < maxBytes; ++i) {
+    const uint8 b = readU8();
+    if (val >> 57) {
+      throw std::range_error("Varint out of range");
+    }
+    val = (val << 7) | (b & 0x7F);
+    if (!(b & 0x80)) {
+      return val;
+    }
+  }
+  throw std::runtime_error("Varint too long");
+}
+
+template<typename T>
+static T narrow(uint64 val) {
+  if (val > std::numeric_limits<T>::max()) {
+    throw std::range_error("Varint out of range");
+  }
+  return static_cast<T>(val);
+}
+
+uint16 InStream::readUV16() {
+  return narrow<uint16>(readVarint(Varint::MaxBytes16));
+}
+uint32 InStream::readUV32() {
+  return narrow<uint32>(readVarint(Varint::MaxBytes32));
+}
+uint64 InStream::readUV64() {
+  return readVarint(Varint::MaxBytes64);
+}
+int16 InStream::readV16() {
+  return static_cast<int16>(Varint::unzigzag(narrow<uint16>(readVarint(Varint::MaxBytes16))));
+}
+int32 InStream::readV32() {
+  return static_cast<int32>(Varint::unzigzag(narrow<uint32>(readVarint(Varint::MaxBytes32))));
+}
+int64 InStream::readV64() {
+  return Varint::unzigzag(readVarint(Varint::MaxBytes64));
+}
+
+void InStream::readUV32s(uint32 *values, SizeT count) {
+  for (SizeT i = 0; i < count; ++i) {
+    values[i] = readUV32();
+  }
+}
+void InStream::readV32s(int32 *values, SizeT count) {
+  uint32 *const zigzagged = reinterpret_cast<uint32*>(values);
+  readUV32s(zigzagged, count);
+  for (SizeT i = 0; i < count; ++i) {
+    values[i] = static_cast<int32>(Varint::unzigzag(zigzagged[i]));
+  }
+}
+
+void OutStream::writeUV16(uint16 i) {
+  writeUV64(i);
+}
+void OutStream::writeUV32(uint32 i) {
+  writeUV64(i);
+}
+void OutStream::writeUV64(uint64 i) {
+  uint8 buf[Varint::MaxBytes64];
+  writeData(buf, Varint::encode(i, buf));
+}
+void OutStream::writeV16(int16 i) {
+  writeUV64(static_cast<uint16>(Varint::zigzag(i)));
+}
+void OutStream::writeV32(int32 i) {
+  writeUV64(static_cast<uint32>(Varint::zigzag(i)));
+}
+void OutStream::writeV64(int64 i) {
+  writeUV64(Varint::zigzag(i));
+}
+
+// Packed varints are encoded to a local buffer, and written in as few writeData calls
+template<typename T, typename F>
+static void writeVarints(OutStream &os, const T *values, Stream::SizeT count, F toUnsigned) {
+  uint8 buf[64 * Varint::MaxBytes32];
+  int len = 0;
+  for (Stream::SizeT i = 0; i < count; ++i) {
+    if (len > static_cast<int>(sizeof(buf)) - Varint::MaxBytes64) {
+      os.writeData(buf, len);
+      len = 0;
+    }
+    len += Varint::encode(toUnsigned(values[i]), buf + len);
+  }
+  os.writeData(buf, len);
+}
+
+void OutStream::writeUV32s(const uint32 *values, SizeT count) {
+  writeVarints(*this, values, count, [](uint32 v) { return v; });
+}
+void OutStream::writeV32s(const int32 *values, SizeT count) {
+  writeVarints(*this, values, count, [](int32 v) {
+    return static_cast<uint32>(Varint::zigzag(v));
+  });
+}
+
 void InStream::skip(SizeT len) {
   byte discard[1024];
   while (len > 0) {
@@ -70,6 +70,24 @@ public:
   virtual float readFloat();
   virtual double readDouble();
   virtual void readData(void *data, SizeT len) = 0;
+
+  ///
+  /// @brief Reads an unsigned varint (see IO::Varint) of at most `maxBytes` bytes.
+  /// @throws std::runtime_error if it is longer.
+  ///
+  virtual uint64 readVarint(int maxBytes);
+  /// @throws std::range_error if the value doesn't fit the type.
+  uint16 readUV16();
+  uint32 readUV32();
+  uint64 readUV64();
+  int16 readV16();
+  int32 readV32();
+  int64 readV64();
+  ///
+  /// @brief Reads `count` consecutive uv32s.
+  ///
+  virtual void readUV32s(uint32 *values, SizeT count);
+  void readV32s(int32 *values, SizeT count);
   virtual void skip(SizeT len);
 
   // goodform::msgpack compatibility
@@ -106,6 +124,19 @@ public:
   virtual void writeDouble(double d);
   virtual void writeData(const void *data, SizeT len) = 0;
 
+  /// Writes varints, see IO::Varint.
+  void writeUV16(uint16);
+  void writeUV32(uint32);
+  void writeUV64(uint64);
+  void writeV16(int16);
+  void writeV32(int32);
+  void writeV64(int64);
+  ///
+  /// @brief Writes `count` consecutive uv32s.
+  ///
+  void writeUV32s(const uint32 *values, SizeT count);
+  void writeV32s(const int32 *values, SizeT count);
+
   // goodform::msgpack compatibility
   bool good() {
     return true;
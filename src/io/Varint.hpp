@@ -0,0 +1,79 @@
+#ifndef DIGGLER_IO_VARINT_HPP
+#define DIGGLER_IO_VARINT_HPP
+
+#include <cstring>
+
+#include "../Platform.hpp"
+
+namespace Diggler {
+namespace IO {
+
+///
+/// @brief Variable-length integer coding, as defined in the spec.
+/// Integers are split in 7-bit groups, most significant first, one per byte. All bytes but the
+/// last have their high bit set. Signed integers are zigzag-encoded first, so that small
+/// negative values stay short.
+///
+namespace Varint {
+
+/// Maximum encoded lengths, in bytes.
+constexpr int MaxBytes16 = 3, MaxBytes32 = 5, MaxBytes64 = 10;
+
+constexpr inline uint64 zigzag(int64 n) {
+  return (static_cast<uint64>(n) << 1) ^ static_cast<uint64>(n >> 63);
+}
+
+constexpr inline int64 unzigzag(uint64 v) {
+  return static_cast<int64>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+///
+/// @returns Encoded length of `v`, in bytes.
+///
+inline int length(uint64 v) {
+  return v == 0 ? 1 : (64 - __builtin_clzll(v) + 6) / 7;
+}
+
+///
+/// @brief Encodes `v` into `out`, which must have room for MaxBytes64 bytes.
+/// @returns Number of bytes written.
+///
+inline int encode(uint64 v, uint8 *out) {
+  const int len = length(v);
+  out[len - 1] = v & 0x7F;
+  for (int i = len - 2; i >= 0; --i) {
+    v >>= 7;
+    out[i] = (v & 0x7F) | 0x80;
+  }
+  return len;
+}
+
+///
+/// @brief Decodes a varint of at most 8 bytes without branching on each byte.
+/// @param in Encoded data, with at least 8 readable bytes even if the varint is shorter.
+/// @param len Set to the varint's length, or 0 if it is longer than 8 bytes.
+///
+inline uint64 decode8(const uint8 *in, int &len) {
+  uint64 w;
+  std::memcpy(&w, in, sizeof(w)); // Little-endian: first byte in the low bits
+  const uint64 last = ~w & 0x8080808080808080ull;
+  if (last == 0) {
+    len = 0;
+    return 0;
+  }
+  len = __builtin_ctzll(last) / 8 + 1;
+  // Keep the varint's bytes, most significant group in the high byte, then squeeze out the
+  // continuation bits
+  uint64 x = __builtin_bswap64(w & 0x7F7F7F7F7F7F7F7Full) >> (64 - len * 8);
+  x = ((x & 0x7F007F007F007F00ull) >> 1) | (x & 0x007F007F007F007Full);
+  x = ((x & 0x3FFF00003FFF0000ull) >> 2) | (x & 0x00003FFF00003FFFull);
+  x = ((x & 0x0FFFFFFF00000000ull) >> 4) | (x & 0x000000000FFFFFFFull);
+  return x;
+}
+
+}
+
+}
+}
+
+#endif /* DIGGLER_IO_VARINT_HPP */
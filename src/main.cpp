@@ -47,8 +47,9 @@ static void showHelp(char **argv) {
   " --help\n\n"
   "Server: -s [-p port]\n"
   " -p port      Specifies port to run server on\n\n"
-  "Client: [--nosound] [-n name] [host[:port]]\n"
+  "Client: [--nosound] [--headless] [-n name] [host[:port]]\n"
   " --nosound    Disables sound\n"
+  " --headless   Runs without a window nor sound, e.g. as a test or load client\n"
   " -n name      Sets player nickname\n"
   " host[:port]  Server (and port) to connect directly to\n"
   << std::endl;
@@ -86,6 +87,14 @@ int main(int argc, char **argv) {
 
     } else if (strcmp(argv[i], "--nosound") == 0) {
       GlobalProperties::IsSoundEnabled = false;
+    } else if (strcmp(argv[i], "--headless") == 0) {
+#if defined(DIGGLER_ENABLE_NULL_RENDERER)
+      GlobalProperties::IsHeadless = true;
+      GlobalProperties::IsSoundEnabled = false;
+#else
+      Log(Failure, TAG) << "Headless mode needs the null renderer, which this build lacks";
+      return 1;
+#endif
     } else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--name") == 0)
       && argc > i) {
       if (strlen(argv[i+1]) > GlobalProperties::PlayerNameMaxLen) {
@@ -16,15 +16,26 @@ ClientMessageHandler::ClientMessageHandler(GameState &gameState) :
   GS(gameState) {
 }
 
-bool ClientMessageHandler::handleMessage(InMessage &msg) {
+void ClientMessageHandler::decode(ReceivedMessage &rm) {
+  switch (rm.msg.getType()) {
+    case MessageType::ChunkTransfer:
+      Client::ChunkTransferHandler::decode(rm);
+      break;
+    default:
+      break;
+  }
+}
+
+bool ClientMessageHandler::handleMessage(ReceivedMessage &rm) {
   using namespace Net::MsgTypes;
+  InMessage &msg = rm.msg;
   switch (msg.getType()) {
     case MessageType::NetDisconnect:
       GS.GW->showMessage("Disconnected", "Timed out");
       return false;
 
     case MessageType::ChunkTransfer:
-      return Client::ChunkTransferHandler::handle(GS, msg);
+      return Client::ChunkTransferHandler::handle(GS, rm);
 
     case MessageType::Chat:
       return Client::ChatHandler::handle(GS, msg);
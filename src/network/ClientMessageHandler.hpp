@@ -1,7 +1,14 @@
 #ifndef DIGGLER_NET_CLIENT_MESSAGE_HANDLER_HPP
 #define DIGGLER_NET_CLIENT_MESSAGE_HANDLER_HPP
 
+#include <memory>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
 #include "Network.hpp"
+#include "../Chunk.hpp"
+#include "../World.hpp"
 
 namespace Diggler {
 
@@ -9,13 +16,35 @@ class GameState;
 
 namespace Net {
 
+///
+/// @brief Message received by the client network thread, along with what that thread already
+/// decoded out of it to spare the game thread.
+///
+struct ReceivedMessage {
+  InMessage msg;
+
+  struct DecodedChunk {
+    WorldId worldId;
+    glm::ivec3 chunkPos;
+    std::unique_ptr<Chunk::Data> data;
+  };
+  /// Decompressed chunks of a ChunkTransfer response, in message order.
+  std::vector<DecodedChunk> chunks;
+};
+
 class ClientMessageHandler {
 public:
   GameState &GS;
 
   ClientMessageHandler(GameState&);
 
-  bool handleMessage(InMessage&);
+  ///
+  /// @brief Decodes the heavy parts of a message, e.g. chunk data.
+  /// Called on the network thread, so it must not touch the game state.
+  ///
+  static void decode(ReceivedMessage&);
+
+  bool handleMessage(ReceivedMessage&);
 };
 
 }
@@ -0,0 +1,144 @@
+#include "InterestManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "../Chunk.hpp"
+#include "../platform/Math.hpp"
+
+namespace Diggler {
+namespace Net {
+
+std::size_t InterestManager::CellKeyHash::operator()(const CellKey &k) const {
+  // Large primes, as in "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+  return static_cast<std::size_t>(
+    (static_cast<uint32>(k.cell.x) * 73856093u) ^ (static_cast<uint32>(k.cell.y) * 19349663u) ^
+    (static_cast<uint32>(k.cell.z) * 83492791u) ^ (static_cast<uint32>(k.world) * 2654435761u));
+}
+
+InterestManager::InterestManager(const Config &config) :
+  m_config(config),
+  m_cellSize(std::max(config.viewDistance, 1)) {
+}
+
+glm::ivec3 InterestManager::cellOf(const glm::ivec3 &chunkPos) const {
+  return glm::ivec3(divrd(chunkPos.x, m_cellSize), divrd(chunkPos.y, m_cellSize),
+    divrd(chunkPos.z, m_cellSize));
+}
+
+void InterestManager::unlink(Player::SessionID id, const Entry &e) {
+  auto it = m_cells.find(CellKey { e.world, e.cell });
+  if (it == m_cells.end()) {
+    return;
+  }
+  std::vector<Player::SessionID> &ids = it->second;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+  if (ids.empty()) {
+    m_cells.erase(it);
+  }
+}
+
+void InterestManager::update(const Player &plr) {
+  const WorldId world = plr.W ? plr.W->id : 0;
+  const glm::ivec3 chunk(
+    divrd(static_cast<int>(std::floor(plr.position.x)), Chunk::CX),
+    divrd(static_cast<int>(std::floor(plr.position.y)), Chunk::CY),
+    divrd(static_cast<int>(std::floor(plr.position.z)), Chunk::CZ));
+  const glm::ivec3 cell = cellOf(chunk);
+
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto it = m_players.find(plr.sessId);
+  if (it == m_players.end()) {
+    it = m_players.emplace(plr.sessId, Entry { plr.peer, world, plr.position, chunk, cell, 0 })
+      .first;
+  } else {
+    Entry &e = it->second;
+    e.peer = plr.peer;
+    e.position = plr.position;
+    e.chunk = chunk;
+    if (e.world == world && e.cell == cell) {
+      return;
+    }
+    unlink(plr.sessId, e);
+    e.world = world;
+    e.cell = cell;
+  }
+  m_cells[CellKey { world, cell }].push_back(plr.sessId);
+}
+
+void InterestManager::remove(Player::SessionID id) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto it = m_players.find(id);
+  if (it != m_players.end()) {
+    unlink(id, it->second);
+    m_players.erase(it);
+  }
+}
+
+void InterestManager::getChunkSubscribers(WorldId world, const glm::ivec3 &chunkPos,
+  std::vector<Peer*> &peers) const {
+  const glm::ivec3 cell = cellOf(chunkPos);
+  std::lock_guard<std::mutex> lk(m_mutex);
+  for (int x = cell.x - 1; x <= cell.x + 1; ++x) {
+    for (int y = cell.y - 1; y <= cell.y + 1; ++y) {
+      for (int z = cell.z - 1; z <= cell.z + 1; ++z) {
+        auto cit = m_cells.find(CellKey { world, glm::ivec3(x, y, z) });
+        if (cit == m_cells.end()) {
+          continue;
+        }
+        for (Player::SessionID id : cit->second) {
+          const Entry &e = m_players.at(id);
+          const glm::ivec3 d = glm::abs(e.chunk - chunkPos);
+          if (std::max(d.x, std::max(d.y, d.z)) <= m_config.viewDistance) {
+            peers.push_back(e.peer);
+          }
+        }
+      }
+    }
+  }
+}
+
+void InterestManager::getMovementRecipients(const Player &mover, std::vector<Peer*> &peers) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto mit = m_players.find(mover.sessId);
+  if (mit == m_players.end()) {
+    return;
+  }
+  Entry &me = mit->second;
+  const uint32 count = me.moveCount++;
+  // Cells that may hold players within the relevance radius
+  const glm::ivec3 span(
+    static_cast<int>(std::ceil(m_config.relevanceRadius / (m_cellSize * Chunk::CX))),
+    static_cast<int>(std::ceil(m_config.relevanceRadius / (m_cellSize * Chunk::CY))),
+    static_cast<int>(std::ceil(m_config.relevanceRadius / (m_cellSize * Chunk::CZ))));
+  for (int x = me.cell.x - span.x; x <= me.cell.x + span.x; ++x) {
+    for (int y = me.cell.y - span.y; y <= me.cell.y + span.y; ++y) {
+      for (int z = me.cell.z - span.z; z <= me.cell.z + span.z; ++z) {
+        auto cit = m_cells.find(CellKey { me.world, glm::ivec3(x, y, z) });
+        if (cit == m_cells.end()) {
+          continue;
+        }
+        for (Player::SessionID id : cit->second) {
+          if (id == mover.sessId) {
+            continue;
+          }
+          const Entry &e = m_players.at(id);
+          const float dist = glm::distance(e.position, me.position);
+          if (dist > m_config.relevanceRadius) {
+            continue;
+          }
+          const uint32 interval = 1 + static_cast<uint32>(dist / m_config.fullRateRadius);
+          if (count % interval == 0) {
+            peers.push_back(e.peer);
+          }
+        }
+      }
+    }
+  }
+}
+
+}
+}
@@ -0,0 +1,95 @@
+#ifndef DIGGLER_NET_INTEREST_MANAGER_HPP
+#define DIGGLER_NET_INTEREST_MANAGER_HPP
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "../platform/PreprocUtils.hpp"
+#include "../Player.hpp"
+
+namespace Diggler {
+namespace Net {
+
+struct Peer;
+
+///
+/// @brief Server-side tracking of which players care about which parts of the world.
+/// Players are bucketed by chunk in a spatial hash. Each is subscribed to the chunks within
+/// `viewDistance` chunks of the one it stands in, and receives other players' movement up to
+/// `relevanceRadius` blocks away, less often the farther they are.
+/// @note Thread-safe.
+///
+class InterestManager {
+public:
+  struct Config {
+    /// Chunk subscription radius, in chunks.
+    int viewDistance;
+    /// Distance past which movement updates aren't sent, in blocks.
+    float relevanceRadius;
+    /// Distance under which every movement update is sent, in blocks. Past it, one update in
+    /// `1 + distance / fullRateRadius` is.
+    float fullRateRadius;
+  };
+
+  InterestManager(const Config&);
+  nocopymove(InterestManager);
+
+  const Config& config() const {
+    return m_config;
+  }
+
+  ///
+  /// @brief Adds the player, or updates its world and position.
+  ///
+  void update(const Player&);
+  void remove(Player::SessionID);
+
+  ///
+  /// @brief Appends the peers of players subscribed to a chunk.
+  ///
+  void getChunkSubscribers(WorldId, const glm::ivec3 &chunkPos, std::vector<Peer*> &peers) const;
+
+  ///
+  /// @brief Appends the peers of players that should get the next movement update of `mover`.
+  /// Advances the mover's update counter, used to send fewer updates to distant players.
+  ///
+  void getMovementRecipients(const Player &mover, std::vector<Peer*> &peers);
+
+private:
+  struct Entry {
+    Peer *peer;
+    WorldId world;
+    glm::vec3 position;
+    glm::ivec3 chunk, cell;
+    uint32 moveCount;
+  };
+  struct CellKey {
+    WorldId world;
+    glm::ivec3 cell;
+
+    bool operator==(const CellKey &o) const {
+      return world == o.world && cell == o.cell;
+    }
+  };
+  struct CellKeyHash {
+    std::size_t operator()(const CellKey&) const;
+  };
+
+  const Config m_config;
+  /// Spatial hash cell size, in chunks. Subscribers of a chunk are at most one cell away.
+  const int m_cellSize;
+  std::unordered_map<Player::SessionID, Entry> m_players;
+  std::unordered_map<CellKey, std::vector<Player::SessionID>, CellKeyHash> m_cells;
+  mutable std::mutex m_mutex;
+
+  glm::ivec3 cellOf(const glm::ivec3 &chunkPos) const;
+  void unlink(Player::SessionID, const Entry&);
+};
+
+}
+}
+
+#endif /* DIGGLER_NET_INTEREST_MANAGER_HPP */
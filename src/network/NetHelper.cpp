@@ -15,21 +15,33 @@ void Broadcast(Game *G, const OutMessage &msg, Tfer tfer, Channels chan) {
   Broadcast(*G, msg, tfer, chan);
 }
 
-void Broadcast(Game &G, const OutMessage &msg, Tfer tfer, Channels chan) {
+static void BroadcastTo(Game &G, const Player *except, const OutMessage &msg, Tfer tfer,
+  Channels chan) {
+  std::vector<Peer*> peers;
+  peers.reserve(G.players.size());
   for (Player &p : G.players) {
-    G.S->H.send(*p.peer, msg, tfer, chan);
+    if (&p != except) {
+      peers.push_back(p.peer);
+    }
   }
+  G.S->H.broadcast(peers, msg, tfer, chan);
+}
+
+void Broadcast(Game &G, const OutMessage &msg, Tfer tfer, Channels chan) {
+  BroadcastTo(G, nullptr, msg, tfer, chan);
 }
 
-void SendChat(Game *G, const std::string &str) {
+void BroadcastExcept(Game &G, const Player &except, const OutMessage &msg, Tfer tfer,
+  Channels chan) {
+  BroadcastTo(G, &except, msg, tfer, chan);
+}
+
+void MakeChat(OutMessage &msg, const std::string &str) {
   Net::MsgTypes::ChatSend cs;
   cs.msg = goodform::object {
     {"plaintext", str}
   };
-
-  OutMessage msg;
   cs.writeToMsg(msg);
-  G->H.send(*G->NS, msg, Tfer::Unseq);
 }
 
 
@@ -13,13 +13,16 @@ namespace NetHelper {
 // Server only
 void Broadcast(Game*, const Net::OutMessage&, Net::Tfer = Net::Tfer::Rel, Net::Channels = Net::Channels::Base);
 void Broadcast(Game&, const Net::OutMessage&, Net::Tfer = Net::Tfer::Rel, Net::Channels = Net::Channels::Base);
+// Broadcasts to all players but one, e.g. the one the message originates from
+void BroadcastExcept(Game&, const Player&, const Net::OutMessage&, Net::Tfer = Net::Tfer::Rel,
+  Net::Channels = Net::Channels::Base);
 void MakeEvent(Net::OutMessage&, Net::EventType, const glm::vec3&);
 void MakeEvent(Net::OutMessage&, Net::EventType, const Player&);
 
 // Client only
 void SendEvent(Game*, Net::EventType);
 
-void SendChat(Game*, const std::string&);
+void MakeChat(Net::OutMessage&, const std::string&);
 
 }
 }
@@ -1,5 +1,6 @@
 #include "Network.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
@@ -11,6 +12,7 @@
 #include <goodform/msgpack.hpp>
 
 #include "../crypto/Random.hpp"
+#include "../io/Varint.hpp"
 #include "../util/Log.hpp"
 #include "msgtypes/ConnectionParam.hpp"
 
@@ -58,6 +60,18 @@ static enet_uint32 TferToFlags(Tfer mode) {
   return 0;
 }
 
+// Messages split from the same container share its packet, and may be freed on another
+// thread than the one receiving
+static void RetainPacket(ENetPacket *pkt) {
+  __atomic_add_fetch(&pkt->referenceCount, 1, __ATOMIC_RELAXED);
+}
+
+static void ReleasePacket(ENetPacket *pkt) {
+  if (__atomic_sub_fetch(&pkt->referenceCount, 1, __ATOMIC_ACQ_REL) == 0) {
+    enet_packet_destroy(pkt);
+  }
+}
+
 Message::Message(MessageType t, uint8 s) :
   MemoryStream(nullptr, 0),
   m_type(t),
@@ -67,7 +81,8 @@ Message::Message(MessageType t, uint8 s) :
 
 InMessage::InMessage() :
   Message(MessageType::Null, 0),
-  m_chan(Channels::Base) {
+  m_chan(Channels::Base),
+  m_packet(nullptr) {
 }
 
 InMessage::~InMessage() {
@@ -81,15 +96,23 @@ void InMessage::setType(MessageType type) {
   m_data = nullptr;
 }
 
-void InMessage::fromData(const void *data, SizeT len, Channels chan) {
-  if (len < HeaderSize) {
+void InMessage::fromPacket(void *packet, Channels chan) {
+  ENetPacket *const pkt = static_cast<ENetPacket*>(packet);
+  fromPacket(packet, chan, pkt->data, pkt->dataLength);
+}
+
+void InMessage::fromPacket(void *packet, Channels chan, const uint8 *bytes, SizeT length) {
+  free();
+  ENetPacket *const pkt = static_cast<ENetPacket*>(packet);
+  RetainPacket(pkt);
+  m_packet = pkt;
+  if (length < HeaderSize) {
+    free();
     throw std::invalid_argument("Message length is smaller than message header");
   }
-  const uint8 *const bytes = static_cast<const uint8*>(data);
-  free();
   m_chan = chan;
   m_cursor = 0;
-  m_length = len - HeaderSize;
+  m_length = length - HeaderSize;
   m_type = static_cast<MessageType>(bytes[0]);
   m_subtype = bytes[1];
   // m_data/bytes is guaranteed never to be written to, so we can const_cast it
@@ -97,8 +120,9 @@ void InMessage::fromData(const void *data, SizeT len, Channels chan) {
 }
 
 void InMessage::free() {
-  if (m_data != nullptr) {
-    delete[] (m_data - HeaderSize);
+  if (m_packet != nullptr) {
+    ReleasePacket(static_cast<ENetPacket*>(m_packet));
+    m_packet = nullptr;
   }
   m_type = MessageType::Null;
   m_subtype = m_length = m_cursor = 0;
@@ -173,9 +197,9 @@ glm::vec3 InMessage::readVec3() {
 
 glm::ivec3 InMessage::readIVec3() {
   int32 x, y, z;
-  x = readI32();
-  y = readI32();
-  z = readI32();
+  x = readV32();
+  y = readV32();
+  z = readV32();
   return glm::ivec3(x, y, z);
 }
 
@@ -198,6 +222,13 @@ bool Peer::operator!=(const Peer &other) const {
 
 void Peer::disconnect(uint32 data) {
   ENetPeer *const peer = reinterpret_cast<ENetPeer*>(this->peer);
+  if (coalescePending) {
+    // ENet stops accepting packets for a disconnecting peer
+    std::lock_guard<std::mutex> lk(host.m_coalesceMutex);
+    for (size_t chan = 0; chan < static_cast<size_t>(Channels::MAX); ++chan) {
+      host.sendCoalesced(*this, static_cast<Channels>(chan));
+    }
+  }
   enet_peer_disconnect(peer, data);
 }
 
@@ -231,14 +262,24 @@ Port Peer::peerPort() {
 Host::Host() :
   host(nullptr),
   rxBytes(0),
-  txBytes(0) {
+  txBytes(0),
+  m_coalescing(false),
+  m_container(nullptr),
+  m_containerPeer(nullptr),
+  m_containerChan(Channels::Base),
+  m_containerPos(0) {
 }
 
 Host::~Host() {
+  releaseContainer();
   ENetHost *const host = reinterpret_cast<ENetHost*>(this->host);
   enet_host_destroy(host);
 }
 
+void Host::setCoalescing(bool coalescing) {
+  m_coalescing = coalescing;
+}
+
 void Host::create(Port port, uint maxconn) {
   if (port == 0) { // Client
     host = enet_host_create(nullptr, 1, static_cast<size_t>(Channels::MAX), 0, 0);
@@ -279,7 +320,16 @@ Peer& Host::connect(const std::string &hostAddr, Port port, Timeout timeout) {
 }
 
 void Host::processPeersToDelete() {
+  if (m_peersToDelete.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(m_coalesceMutex);
   for (Peer *peer : m_peersToDelete) {
+    if (peer->coalescePending) {
+      m_coalescingPeers.erase(
+        std::remove(m_coalescingPeers.begin(), m_coalescingPeers.end(), peer),
+        m_coalescingPeers.end());
+    }
     delete peer;
   }
   m_peersToDelete.clear();
@@ -301,6 +351,56 @@ void Host::sendKeyExchange(Peer &p) {
   std::cout << std::dec << std::endl;
 }*/
 
+bool Host::handleConnectionParam(InMessage &msg, Peer &peer) {
+  using CPS = MsgTypes::ConnectionParamSubtype;
+  if (msg.getType() != MessageType::ConnectionParam ||
+      msg.getSubtype<CPS>() != CPS::DHKeyExchange) {
+    return false;
+  }
+  MsgTypes::ConnectionParamDHKeyExchange dhke; dhke.readFromMsg(msg);
+  peer.remotePk = dhke.pk;
+  if (Crypto::DiffieHellman::scalarmult(peer.connectionSk, peer.remotePk,
+    peer.sharedSecret) != 0) {
+    // TODO: properly handle key exchange failure
+    throw std::runtime_error("DH key exchange failed");
+  }
+  Log(Debug, TAG) << "hello DH! " << peer.sharedSecret.hex();
+  return true;
+}
+
+bool Host::nextContained(InMessage &msg) {
+  const ENetPacket *const pkt = static_cast<const ENetPacket*>(m_container);
+  if (m_containerPos >= pkt->dataLength) {
+    releaseContainer();
+    return false;
+  }
+  uint16 length;
+  try {
+    IO::InMemoryStream ims(pkt->data + m_containerPos, pkt->dataLength - m_containerPos);
+    length = ims.readUV16();
+    m_containerPos += ims.tell();
+  } catch (...) {
+    releaseContainer();
+    throw;
+  }
+  if (length > pkt->dataLength - m_containerPos) {
+    releaseContainer();
+    throw std::invalid_argument("Contained message length exceeds its container");
+  }
+  const uint8 *const data = pkt->data + m_containerPos;
+  m_containerPos += length;
+  msg.fromPacket(m_container, m_containerChan, data, length);
+  return true;
+}
+
+void Host::releaseContainer() {
+  if (m_container != nullptr) {
+    ReleasePacket(static_cast<ENetPacket*>(m_container));
+    m_container = nullptr;
+    m_containerPeer = nullptr;
+  }
+}
+
 bool Host::recv(InMessage &msg, Peer **peer, Timeout timeout) {
   ENetHost *const host = reinterpret_cast<ENetHost*>(this->host);
   processPeersToDelete();
@@ -308,10 +408,31 @@ bool Host::recv(InMessage &msg, Peer **peer, Timeout timeout) {
 
   ENetEvent event;
   while (true) {
-    auto now = std::chrono::steady_clock::now();
-    enet_uint32 elapsed = static_cast<enet_uint32>(
-      std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count());
-    if (enet_host_service(host, &event, timeout - elapsed) > 0) {
+    // Messages of a container are returned before any later event
+    if (m_container != nullptr) {
+      Peer *const peerPtr = m_containerPeer;
+      if (nextContained(msg)) {
+        if (!handleConnectionParam(msg, *peerPtr)) {
+          if (peer) {
+            *peer = peerPtr;
+          }
+          return true;
+        }
+        continue;
+      }
+    }
+    int eventStatus = enet_host_check_events(host, &event);
+    if (eventStatus == 0) {
+      if (m_coalescing) {
+        std::lock_guard<std::mutex> lk(m_coalesceMutex);
+        sendAllCoalesced();
+      }
+      auto now = std::chrono::steady_clock::now();
+      enet_uint32 elapsed = static_cast<enet_uint32>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count());
+      eventStatus = enet_host_service(host, &event, elapsed >= timeout ? 0 : timeout - elapsed);
+    }
+    if (eventStatus > 0) {
       Peer *peerPtr = event.peer == nullptr ? nullptr :
         reinterpret_cast<Peer*>(event.peer->data);
       switch (event.type) {
@@ -328,32 +449,25 @@ bool Host::recv(InMessage &msg, Peer **peer, Timeout timeout) {
           *peer = peerPtr;
         }
 
-        const Message::SizeT pktLen = event.packet->dataLength;
+        ENetPacket *const packet = event.packet;
         const Channels pktChannel = static_cast<Channels>(event.channelID);
         const bool decrypt = (pktChannel == Channels::ConnectionMetaPlain);
-        byte *rcvData = new uint8[pktLen];
         if (decrypt) {
-          // TODO: decryption
-          std::memcpy(rcvData, event.packet->data, pktLen);
-        } else {
-          std::memcpy(rcvData, event.packet->data, pktLen);
+          // TODO: decryption, done in place in the packet's buffer
         }
-        // pktData's ownership is transferred to msg
-        msg.fromData(rcvData, pktLen, pktChannel);
-        rxBytes += event.packet->dataLength;
-
-        using CPS = MsgTypes::ConnectionParamSubtype;
-        if (msg.getType() == MessageType::ConnectionParam &&
-            msg.getSubtype<CPS>() == CPS::DHKeyExchange) {
-          MsgTypes::ConnectionParamDHKeyExchange dhke; dhke.readFromMsg(msg);
-          peerPtr->remotePk = dhke.pk;
-          if (Crypto::DiffieHellman::scalarmult(peerPtr->connectionSk, peerPtr->remotePk,
-            peerPtr->sharedSecret) != 0) {
-            // TODO: properly handle key exchange failure
-            throw std::runtime_error("DH key exchange failed");
-          }
-          Log(Debug, TAG) << "hello DH! " << peerPtr->sharedSecret.hex();
-        } else {
+        rxBytes += packet->dataLength;
+        // packet's ownership is transferred to msg, which reads it in place
+        msg.fromPacket(packet, pktChannel);
+
+        if (msg.getType() == MessageType::NetContainer) {
+          // Keep the packet alive while its messages are handed out
+          RetainPacket(packet);
+          m_container = packet;
+          m_containerPeer = peerPtr;
+          m_containerChan = pktChannel;
+          m_containerPos = Message::HeaderSize;
+          msg.free();
+        } else if (!handleConnectionParam(msg, *peerPtr)) {
           return true;
         }
       } break;
@@ -372,9 +486,116 @@ bool Host::recv(InMessage &msg, Peer **peer, Timeout timeout) {
   throw Exception();
 }
 
-void Host::send(Peer &peer, const OutMessage &msg, Tfer mode, Channels chan) {
+static bool IsEncrypted(Channels chan) {
+  return chan == Channels::ConnectionMetaPlain;
+}
+
+static ENetPacket* CreatePacket(Tfer mode, const byte *header, const byte *actualData,
+  size_t pktLen) {
+  ENetPacket *packet = enet_packet_create(nullptr, pktLen, TferToFlags(mode));
+  std::memcpy(packet->data, header, Message::HeaderSize);
+  if (actualData != nullptr) {
+    std::memcpy(packet->data + Message::HeaderSize, actualData + Message::HeaderSize,
+      pktLen - Message::HeaderSize);
+  }
+  return packet;
+}
+
+///
+/// @returns Largest packet that fits in a single datagram to the peer, in bytes.
+///
+static size_t SingleDatagramPayload(const ENetHost *host, const ENetPeer *peer) {
+  size_t overhead = sizeof(ENetProtocolHeader) + sizeof(ENetProtocolSendUnsequenced);
+  if (host->checksum != nullptr) {
+    overhead += sizeof(enet_uint32);
+  }
+  return peer->mtu - overhead;
+}
+
+bool Host::coalesce(Peer &peer, const OutMessage &msg, Tfer mode, Channels chan) {
+  const size_t msgLen = Message::HeaderSize +
+    (msg.m_actualData == nullptr ? 0 : msg.m_length);
+  const size_t needed = IO::Varint::length(msgLen) + msgLen;
+  const size_t maxLen = SingleDatagramPayload(reinterpret_cast<const ENetHost*>(host),
+    reinterpret_cast<const ENetPeer*>(peer.peer));
+  Peer::CoalesceQueue &q = peer.coalesceQueues[static_cast<size_t>(chan)];
+  if (q.count > 0 && (q.mode != mode || q.data.size() + needed > maxLen)) {
+    sendCoalesced(peer, chan);
+  }
+  if (Message::HeaderSize + needed > maxLen) {
+    // Sent on its own, after what was queued on the channel
+    return false;
+  }
+  if (q.count == 0) {
+    q.mode = mode;
+    q.data.reserve(maxLen);
+    q.data.push_back(static_cast<uint8>(MessageType::NetContainer));
+    q.data.push_back(0);
+    if (!peer.coalescePending) {
+      peer.coalescePending = true;
+      m_coalescingPeers.push_back(&peer);
+    }
+  }
+  uint8 prefix[IO::Varint::MaxBytes64];
+  q.data.insert(q.data.end(), prefix, prefix + IO::Varint::encode(msgLen, prefix));
+  q.data.push_back(static_cast<uint8>(msg.m_type));
+  q.data.push_back(msg.m_subtype);
+  if (msg.m_actualData != nullptr) {
+    const uint8 *const payload = msg.m_actualData + Message::HeaderSize;
+    q.data.insert(q.data.end(), payload, payload + msg.m_length);
+  }
+  ++q.count;
+  return true;
+}
+
+void Host::sendCoalesced(Peer &peer, Channels chan) {
+  Peer::CoalesceQueue &q = peer.coalesceQueues[static_cast<size_t>(chan)];
+  if (q.count == 0) {
+    return;
+  }
+  size_t start = 0;
+  if (q.count == 1) {
+    // Not worth a container, skip its header and the length prefix
+    start = Message::HeaderSize;
+    while (q.data[start++] & 0x80);
+  }
+  const size_t pktLen = q.data.size() - start;
+  ENetPacket *packet = enet_packet_create(q.data.data() + start, pktLen, TferToFlags(q.mode));
+  if (enet_peer_send(reinterpret_cast<ENetPeer*>(peer.peer), static_cast<uint8>(chan),
+      packet) == 0) {
+    txBytes += pktLen;
+  } else {
+    enet_packet_destroy(packet);
+  }
+  q.data.clear();
+  q.count = 0;
+}
+
+void Host::sendAllCoalesced() {
+  for (Peer *peer : m_coalescingPeers) {
+    for (size_t chan = 0; chan < static_cast<size_t>(Channels::MAX); ++chan) {
+      sendCoalesced(*peer, static_cast<Channels>(chan));
+    }
+    peer->coalescePending = false;
+  }
+  m_coalescingPeers.clear();
+}
+
+void Host::send(Peer &peer, const OutMessage &msg, Tfer mode, Channels chan, Flush flush) {
   ENetHost *const host = reinterpret_cast<ENetHost*>(this->host);
-  const bool encrypt = (chan == Channels::ConnectionMetaPlain);
+  const bool encrypt = IsEncrypted(chan);
+
+  std::unique_lock<std::mutex> lk(m_coalesceMutex, std::defer_lock);
+  if (m_coalescing) {
+    lk.lock();
+    if (!encrypt && coalesce(peer, msg, mode, chan)) {
+      if (flush == Flush::Immediate) {
+        sendAllCoalesced();
+        enet_host_flush(host);
+      }
+      return;
+    }
+  }
 
   const byte header[Message::HeaderSize] = {
     static_cast<byte>(msg.m_type),
@@ -382,28 +603,82 @@ void Host::send(Peer &peer, const OutMessage &msg, Tfer mode, Channels chan) {
   };
 
   size_t pktLen = Message::HeaderSize + (msg.m_actualData == nullptr ? 0 : msg.m_length);
-  ENetPacket *packet = enet_packet_create(nullptr, pktLen, TferToFlags(mode));
-  byte *pktData = packet->data;
+  ENetPacket *packet = CreatePacket(mode, header, msg.m_actualData, pktLen);
   txBytes += pktLen;
-  if (msg.m_actualData != nullptr) {
-    std::memcpy(msg.m_actualData, header, Message::HeaderSize);
-    if (encrypt) {
-      // TODO: don't memcpy, encrypt!
-      std::memcpy(pktData, msg.m_actualData, pktLen);
-    } else {
-      std::memcpy(pktData, msg.m_actualData, pktLen);
+  if (encrypt) {
+    // TODO: encrypt in place with the peer's key
+  }
+
+  //hexDump('S', packet->data, pktLen);
+  enet_peer_send(reinterpret_cast<ENetPeer*>(peer.peer), static_cast<uint8>(chan), packet);
+  if (flush == Flush::Immediate) {
+    if (m_coalescing) {
+      sendAllCoalesced();
     }
-  } else {
-    if (encrypt) {
-      // TODO: don't memcpy, encrypt!
-      std::memcpy(pktData, header, pktLen);
-    } else {
-      std::memcpy(pktData, header, pktLen);
+    enet_host_flush(host);
+  }
+}
+
+void Host::broadcast(const std::vector<Peer*> &peers, const OutMessage &msg, Tfer mode,
+  Channels chan, Flush flush) {
+  if (IsEncrypted(chan)) {
+    for (Peer *peer : peers) {
+      send(*peer, msg, mode, chan, Flush::Deferred);
+    }
+    if (flush == Flush::Immediate) {
+      this->flush();
     }
+    return;
   }
 
-  //hexDump('S', pktData, pktLen);
-  enet_peer_send(reinterpret_cast<ENetPeer*>(peer.peer), static_cast<uint8>(chan), packet);
+  ENetHost *const host = reinterpret_cast<ENetHost*>(this->host);
+  std::unique_lock<std::mutex> lk(m_coalesceMutex, std::defer_lock);
+  // Peers the message is sent to as a shared packet, rather than queued
+  const std::vector<Peer*> *sharing = &peers;
+  std::vector<Peer*> notCoalesced;
+  if (m_coalescing) {
+    lk.lock();
+    for (Peer *peer : peers) {
+      if (!coalesce(*peer, msg, mode, chan)) {
+        notCoalesced.push_back(peer);
+      }
+    }
+    sharing = &notCoalesced;
+  }
+
+  if (!sharing->empty()) {
+    const byte header[Message::HeaderSize] = {
+      static_cast<byte>(msg.m_type),
+      msg.m_subtype
+    };
+    const size_t pktLen = Message::HeaderSize +
+      (msg.m_actualData == nullptr ? 0 : msg.m_length);
+    ENetPacket *packet = CreatePacket(mode, header, msg.m_actualData, pktLen);
+    // ENet refcounts the packet for each peer it's queued to
+    for (Peer *peer : *sharing) {
+      if (enet_peer_send(reinterpret_cast<ENetPeer*>(peer->peer), static_cast<uint8>(chan),
+          packet) == 0) {
+        txBytes += pktLen;
+      }
+    }
+    if (packet->referenceCount == 0) {
+      enet_packet_destroy(packet);
+    }
+  }
+  if (flush == Flush::Immediate) {
+    if (m_coalescing) {
+      sendAllCoalesced();
+    }
+    enet_host_flush(host);
+  }
+}
+
+void Host::flush() {
+  ENetHost *const host = reinterpret_cast<ENetHost*>(this->host);
+  if (m_coalescing) {
+    std::lock_guard<std::mutex> lk(m_coalesceMutex);
+    sendAllCoalesced();
+  }
   enet_host_flush(host);
 }
 
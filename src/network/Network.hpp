@@ -1,8 +1,11 @@
 #ifndef NETWORK_HPP
 #define NETWORK_HPP
 
+#include <atomic>
 #include <exception>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include <glm/vec3.hpp>
 
@@ -26,6 +29,15 @@ enum class Tfer {
   Unseq
 };
 
+/// When a sent message leaves the host.
+enum class Flush {
+  /// Queued until the next Host::flush() or Host::recv() going to the socket, so that messages
+  /// to the same peer share datagrams.
+  Deferred,
+  /// Sent right away, along with everything queued before it.
+  Immediate
+};
+
 enum class Channels : uint8 {
   Base = 0,
   ConnectionMeta,
@@ -56,7 +68,10 @@ enum class MessageType : uint8 {
   Chat,
 
   NetConnect = 240,
-  NetDisconnect
+  NetDisconnect,
+  /// Several messages packed by Host into one packet, each prefixed by its uv16 length.
+  /// Never returned by Host::recv, which splits it.
+  NetContainer
 };
 
 enum QuitReason : uint8 {
@@ -97,8 +112,12 @@ class InMessage : public Message, public IO::InMemoryStream {
 protected:
   friend class Host;
   Channels m_chan;
+  /// ENetPacket the message is read from in place, holding a reference to it.
+  void *m_packet;
   void setType(MessageType type);
-  void fromData(const void *data, SizeT, Channels);
+  void fromPacket(void *packet, Channels);
+  /// Reads the message found at `data` within the packet, e.g. one out of a container.
+  void fromPacket(void *packet, Channels, const uint8 *data, SizeT length);
   void free();
 
 public:
@@ -146,15 +165,16 @@ public:
     writeFloat(vec.y);
     writeFloat(vec.z);
   }
+  /// Writes an integer vector as 3 v32s.
   inline void writeIVec3(int x, int y, int z) {
-    writeI32(x);
-    writeI32(y);
-    writeI32(z);
+    writeV32(x);
+    writeV32(y);
+    writeV32(z);
   }
   inline void writeIVec3(const glm::ivec3 &vec) {
-    writeI32(vec.x);
-    writeI32(vec.y);
-    writeI32(vec.z);
+    writeV32(vec.x);
+    writeV32(vec.y);
+    writeV32(vec.z);
   }
 
   void writeMsgpack(const goodform::variant&);
@@ -177,6 +197,16 @@ struct Peer {
   Host &host;
   void *const peer;
 
+  /// Messages waiting to be sent in a container packet, per channel. See Host::setCoalescing.
+  struct CoalesceQueue {
+    /// Container packet being built, header included.
+    std::vector<uint8> data;
+    Tfer mode;
+    uint count = 0;
+  } coalesceQueues[static_cast<size_t>(Channels::MAX)];
+  /// Whether any of coalesceQueues isn't empty.
+  bool coalescePending = false;
+
   Peer(Host&, void*);
   nocopy(Peer);
   nomove(Peer);
@@ -199,11 +229,32 @@ struct Peer {
 
 class Host {
 private:
+  friend struct Peer;
+
   std::vector<Peer*> m_peersToDelete;
   void processPeersToDelete();
 
   void *host;
-  uint64 rxBytes, txBytes;
+  /// Byte counters, readable from any thread.
+  std::atomic<uint64> rxBytes, txBytes;
+
+  bool m_coalescing;
+  /// Peers with queued messages. Along with their queues, guarded by m_coalesceMutex.
+  std::vector<Peer*> m_coalescingPeers;
+  std::mutex m_coalesceMutex;
+  bool coalesce(Peer&, const OutMessage&, Tfer, Channels);
+  void sendCoalesced(Peer&, Channels);
+  void sendAllCoalesced();
+
+  /// Received container packet recv is splitting, holding a reference to it.
+  void *m_container;
+  Peer *m_containerPeer;
+  Channels m_containerChan;
+  size_t m_containerPos;
+  bool nextContained(InMessage&);
+  void releaseContainer();
+
+  bool handleConnectionParam(InMessage&, Peer&);
 
   Host(const Host&) = delete;
   Host& operator=(Host&) = delete;
@@ -220,10 +271,39 @@ public:
   void create(Port port = 0, uint maxconn = 64);
   Peer& connect(const std::string &hostAddr, Port port, Timeout timeout);
 
-  void send(Peer &peer, const OutMessage &msg, Tfer mode = Tfer::Rel, Channels chan = Channels::Base);
+  /**
+   * @brief Enables packing of deferred messages to the same peer and channel into one packet.
+   * Messages are queued until the packet would exceed the peer's MTU, the mode changes, or
+   * they get flushed, instead of each being its own ENet packet with its own command header
+   * and, if reliable, acknowledgement. Messages too large to share a packet, and ones on
+   * encrypted channels, are sent as usual. Order within a channel is kept.
+   * Should be set before sending anything. Containers are always understood by recv.
+   */
+  void setCoalescing(bool);
+  inline bool isCoalescing() const {
+    return m_coalescing;
+  }
+
+  void send(Peer &peer, const OutMessage &msg, Tfer mode = Tfer::Rel,
+    Channels chan = Channels::Base, Flush flush = Flush::Deferred);
+
+  /**
+   * @brief Sends the same message to several peers, serializing it in a single shared packet.
+   * Messages on encrypted channels are sent one by one instead, as each peer has its own key.
+   */
+  void broadcast(const std::vector<Peer*> &peers, const OutMessage &msg, Tfer mode = Tfer::Rel,
+    Channels chan = Channels::Base, Flush flush = Flush::Deferred);
+
+  /**
+   * @brief Sends all queued messages, at most one datagram batch per peer.
+   * Meant to be called once per tick, after its messages were sent.
+   */
+  void flush();
 
   // Returns true if a message is available, and put it in msg.
   // msg may be modified even if recv returns false.
+  // Already received events are returned first; the socket is only polled, which also flushes
+  // queued messages, once there are none left.
   // If the msg is a NetDisconnect, returned peer object is put on a deletion list and will be
   // freed upon the next call to recv.
   bool recv(InMessage &msg, Peer **peer, Timeout timeout);
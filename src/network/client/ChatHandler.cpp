@@ -3,6 +3,7 @@
 #include "../../Chatbox.hpp"
 #include "../../Game.hpp"
 #include "../../GameState.hpp"
+#include "../../util/Log.hpp"
 #include "../msgtypes/Chat.hpp"
 
 namespace Diggler {
@@ -10,6 +11,19 @@ namespace Net {
 namespace Client {
 
 using namespace Net::MsgTypes;
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "CNH:Chat";
+
+static void showChatEntry(GameState &GS, const std::string &entry) {
+  // Headless clients have no chatbox
+  if (GS.m_chatBox == nullptr) {
+    Log(Info, TAG) << entry;
+    return;
+  }
+  GS.m_chatBox->addChatEntry(entry);
+}
 
 bool ChatHandler::handle(GameState &GS, InMessage &msg) {
   using S = ChatSubtype;
@@ -22,7 +36,7 @@ bool ChatHandler::handle(GameState &GS, InMessage &msg) {
       ca.readFromMsg(msg);
       // TODO better formatting abilities
       if (ca.msg.is<goodform::object>()) {
-        GS.m_chatBox->addChatEntry(ca.msg["plaintext"].get<std::string>());
+        showChatEntry(GS, ca.msg["plaintext"].get<std::string>());
       }
     } break;
     case S::PlayerTalk: {
@@ -41,7 +55,7 @@ bool ChatHandler::handle(GameState &GS, InMessage &msg) {
         } else if (cpt.player.display.is<std::string>()) {
           cpt.player.display.get<std::string>(playerName);
         }
-        GS.m_chatBox->addChatEntry(playerName + cpt.msg.get<std::string>());
+        showChatEntry(GS, playerName + cpt.msg.get<std::string>());
       }
     } break;
   }
@@ -2,34 +2,57 @@
 
 #include "../../Game.hpp"
 #include "../../GameState.hpp"
+#include "../../util/Log.hpp"
 #include "../msgtypes/ChunkTransfer.hpp"
 
 namespace Diggler {
 namespace Net {
 namespace Client {
 
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "CNH:ChunkTransfer";
+
 using namespace Net::MsgTypes;
 
-bool ChunkTransferHandler::handle(GameState &GS, InMessage &msg) {
+void ChunkTransferHandler::decode(ReceivedMessage &rm) {
+  if (rm.msg.getSubtype<ChunkTransferSubtype>() != ChunkTransferSubtype::Response) {
+    return;
+  }
+  ChunkTransferResponse ctr;
+  ctr.readFromMsg(rm.msg);
+  rm.chunks.reserve(ctr.chunks.size());
+  for (const ChunkTransferResponse::ChunkData &cd : ctr.chunks) {
+    std::unique_ptr<Chunk::Data> data(new Chunk::Data);
+    IO::InMemoryStream ims(cd.data, cd.dataLength);
+    if (!Chunk::decode(ims, *data)) {
+      Log(Error, TAG) << "Chunk[" << cd.chunkPos.x << ',' << cd.chunkPos.y << ' ' <<
+        cd.chunkPos.z << "] read failed";
+    }
+    rm.chunks.emplace_back(ReceivedMessage::DecodedChunk {
+      cd.worldId, cd.chunkPos, std::move(data) });
+  }
+}
+
+bool ChunkTransferHandler::handle(GameState &GS, ReceivedMessage &rm) {
   using S = ChunkTransferSubtype;
-  switch (msg.getSubtype<S>()) {
+  switch (rm.msg.getSubtype<S>()) {
     case S::Request: {
       ; // No-op
     } break;
     case S::Response: {
-      ChunkTransferResponse ctr;
-      ctr.readFromMsg(msg);
-      for (const ChunkTransferResponse::ChunkData &cd : ctr.chunks) {
-        ChunkRef c = GS.G->U->getLoadWorld(cd.worldId)->getNewEmptyChunk(
-          cd.chunkPos.x, cd.chunkPos.y, cd.chunkPos.z);
-        IO::InMemoryStream ims(cd.data, cd.dataLength);
-        c->read(ims);
+      // Decompressed by decode(), only left to be put in the world
+      for (const ReceivedMessage::DecodedChunk &dc : rm.chunks) {
+        ChunkRef c = GS.G->U->getLoadWorld(dc.worldId)->getNewEmptyChunk(
+          dc.chunkPos.x, dc.chunkPos.y, dc.chunkPos.z);
+        c->load(*dc.data);
         GS.holdChunksInMem.push_back(c);
       }
     } break;
     case S::Denied: {
       ChunkTransferDenied ctd;
-      ctd.readFromMsg(msg);
+      ctd.readFromMsg(rm.msg);
     } break;
   }
   return true;
@@ -5,11 +5,18 @@
 
 namespace Diggler {
 namespace Net {
+
+struct ReceivedMessage;
+
 namespace Client {
 
 class ChunkTransferHandler : public Handler {
 public:
-  static bool handle(GameState&, InMessage&);
+  ///
+  /// @brief Decompresses the chunks of a response, off the game thread.
+  ///
+  static void decode(ReceivedMessage&);
+  static bool handle(GameState&, ReceivedMessage&);
 };
 
 }
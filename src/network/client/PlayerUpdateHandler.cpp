@@ -37,6 +37,39 @@ bool PlayerUpdateHandler::handle(GameState &GS, InMessage &msg) {
       plr->setPosVel(pos, vel, acc);
       plr->angle = pum.angle;
     } break;
+    case S::Snapshot: {
+      PlayerUpdateSnapshot pus;
+      pus.readFromMsg(msg);
+      if (GS.snapshotClock.valid && pus.tick <= GS.snapshotClock.tick) {
+        // A newer one was already received
+        return true;
+      }
+      if (pus.baselineTick != 0) {
+        const PlayerUpdateSnapshot *baseline = nullptr;
+        for (const PlayerUpdateSnapshot &s : GS.receivedSnapshots) {
+          if (s.tick == pus.baselineTick) {
+            baseline = &s;
+          }
+        }
+        if (!baseline || !pus.applyBaseline(*baseline)) {
+          Log(Debug, TAG) << "Snapshot #" << pus.tick << ": bad baseline #" << pus.baselineTick;
+          return true;
+        }
+      }
+      GS.snapshotClock.onSnapshot(pus.tick, pus.tickInterval / 1000.0, GS.G->Time);
+      for (const PlayerUpdateSnapshot::PlayerState &ps : pus.players) {
+        Player *plr = GS.G->players.getBySessId(ps.plrSessId);
+        if (!plr) {
+          Log(Debug, TAG) << "Snapshot: sess#" << ps.plrSessId << " is not on server";
+          continue;
+        }
+        plr->addSnapshot(Player::Snapshot { pus.tick, ps.position, ps.velocity, ps.angle });
+      }
+      if (GS.receivedSnapshots.size() == PlayerUpdateSnapshot::BaselineHistory) {
+        GS.receivedSnapshots.pop_front();
+      }
+      GS.receivedSnapshots.emplace_back(std::move(pus));
+    } break;
     case S::Die: {
       PlayerUpdateDie pud;
       pud.readFromMsg(msg);
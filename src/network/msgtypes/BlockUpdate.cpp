@@ -1,46 +1,142 @@
 #include "BlockUpdate.hpp"
 
 #include <limits>
+#include <map>
 #include <stdexcept>
+#include <tuple>
+
+#include "../../Chunk.hpp"
+#include "../../platform/Math.hpp"
 
 namespace Diggler {
 namespace Net {
 namespace MsgTypes {
 
+// Index of a block in its chunk, on the low bits of an update's header
+constexpr static int CellBits = 12;
+static_assert(Chunk::CX * Chunk::CY * Chunk::CZ <= (1 << CellBits),
+  "Chunk block indices don't fit in BlockUpdateNotify cells");
+// Fields following an update's header
+enum FieldFlags : uint16 {
+  FieldId = 1 << CellBits,
+  FieldData = 2 << CellBits,
+  FieldLight = 4 << CellBits,
+  FieldExtdata = 8 << CellBits,
+  CellMask = (1 << CellBits) - 1
+};
+
+static glm::ivec3 chunkOf(const glm::ivec3 &pos) {
+  return glm::ivec3(divrd(pos.x, Chunk::CX), divrd(pos.y, Chunk::CY), divrd(pos.z, Chunk::CZ));
+}
+
 void BlockUpdateNotify::writeToMsg(OutMessage &msg) const {
   msg.setType(MessageType::BlockUpdate, BlockUpdateSubtype::Notify);
 
   if (updates.size() > std::numeric_limits<uint16>::max()) {
     throw std::runtime_error("Too many block updates in a single message");
   }
-  msg.writeU16(static_cast<uint16>(updates.size()));
+  // Group updates by world, chunk and cause, keeping their order within each group
+  struct Group {
+    WorldId worldId;
+    glm::ivec3 chunk;
+    UpdateData::Cause cause;
+    std::vector<const UpdateData*> updates;
+  };
+  std::vector<Group> groups;
+  std::map<std::tuple<WorldId, int, int, int, uint8>, size_t> groupIndices;
+  size_t current = 0;
   for (const UpdateData &upd : updates) {
-    msg.writeU8(*reinterpret_cast<const uint8*>(&upd.updated));
-    msg.writeI32(upd.worldId);
-    msg.writeIVec3(upd.pos);
-    msg.writeU16(upd.id);
-    msg.writeU16(upd.data);
-    msg.writeMsgpack(upd.extdata);
-    msg.writeU16(upd.light);
-    msg.writeU8(upd.cause);
+    const glm::ivec3 chunk = chunkOf(upd.pos);
+    // Updates mostly come in runs from the same chunk, sparing most lookups
+    if (groups.empty() || groups[current].worldId != upd.worldId ||
+        groups[current].chunk != chunk || groups[current].cause != upd.cause) {
+      current = groupIndices.emplace(std::make_tuple(upd.worldId, chunk.x, chunk.y, chunk.z,
+        static_cast<uint8>(upd.cause)), groups.size()).first->second;
+      if (current == groups.size()) {
+        groups.push_back(Group { upd.worldId, chunk, upd.cause, {} });
+      }
+    }
+    groups[current].updates.push_back(&upd);
+  }
+
+  msg.writeUV16(static_cast<uint16>(groups.size()));
+  for (const Group &group : groups) {
+    msg.writeV32(group.worldId);
+    msg.writeIVec3(group.chunk);
+    msg.writeU8(group.cause);
+    msg.writeUV16(static_cast<uint16>(group.updates.size()));
+    const UpdateData *prev = nullptr;
+    for (const UpdateData *upd : group.updates) {
+      const glm::ivec3 cell = upd->pos - group.chunk * glm::ivec3(Chunk::CX, Chunk::CY, Chunk::CZ);
+      const BlockId prevId = prev ? prev->id : 0;
+      const BlockData prevData = prev ? prev->data : 0;
+      const uint16 prevLight = prev ? prev->light.l : 0;
+      const uint16 header = static_cast<uint16>(
+        (cell.x + cell.y * Chunk::CX + cell.z * Chunk::CX * Chunk::CY) |
+        (upd->id != prevId ? FieldId : 0) |
+        (upd->data != prevData ? FieldData : 0) |
+        (upd->light.l != prevLight ? FieldLight : 0) |
+        (upd->updated.extdata ? FieldExtdata : 0));
+      msg.writeU16(header);
+      if (header & FieldId) {
+        msg.writeUV16(upd->id);
+      }
+      if (header & FieldData) {
+        msg.writeUV16(upd->data);
+      }
+      if (header & FieldLight) {
+        msg.writeU16(upd->light.l);
+      }
+      if (header & FieldExtdata) {
+        msg.writeMsgpack(upd->extdata);
+      }
+      prev = upd;
+    }
   }
 }
 
 void BlockUpdateNotify::readFromMsg(InMessage &msg) {
-  uint16 count = msg.readU16();
   updates.clear();
-  updates.reserve(count);
-  for (uint8 i  = 0; i < count; ++i) {
-    updates.emplace_back();
-    UpdateData &upd = updates.back();
-    *reinterpret_cast<uint8*>(&upd.updated) = msg.readU8();
-    upd.worldId = msg.readI32();
-    upd.pos = msg.readIVec3();
-    upd.id = msg.readU16();
-    upd.data = msg.readU16();
-    msg.readMsgpack(upd.extdata);
-    upd.light = msg.readU16();
-    upd.cause = static_cast<UpdateData::Cause>(msg.readU8());
+  const uint16 groupCount = msg.readUV16();
+  for (uint16 g = 0; g < groupCount; ++g) {
+    const WorldId worldId = msg.readV32();
+    const glm::ivec3 chunkOrigin = msg.readIVec3() * glm::ivec3(Chunk::CX, Chunk::CY, Chunk::CZ);
+    const UpdateData::Cause cause = static_cast<UpdateData::Cause>(msg.readU8());
+    const uint16 count = msg.readUV16();
+    if (updates.size() + count > std::numeric_limits<uint16>::max()) {
+      throw std::runtime_error("Too many block updates in a single message");
+    }
+    updates.reserve(updates.size() + count);
+    BlockId id = 0;
+    BlockData data = 0;
+    uint16 light = 0;
+    for (uint16 i = 0; i < count; ++i) {
+      const uint16 header = msg.readU16();
+      if (header & FieldId) {
+        id = msg.readUV16();
+      }
+      if (header & FieldData) {
+        data = msg.readUV16();
+      }
+      if (header & FieldLight) {
+        light = msg.readU16();
+      }
+      updates.emplace_back();
+      UpdateData &upd = updates.back();
+      const int index = header & CellMask;
+      upd.worldId = worldId;
+      upd.pos = chunkOrigin + glm::ivec3(index % Chunk::CX, (index / Chunk::CX) % Chunk::CY,
+        index / (Chunk::CX * Chunk::CY));
+      upd.id = id;
+      upd.data = data;
+      upd.light = light;
+      upd.cause = cause;
+      upd.updated.id = upd.updated.data = upd.updated.light = 1;
+      upd.updated.extdata = (header & FieldExtdata) ? 1 : 0;
+      if (upd.updated.extdata) {
+        msg.readMsgpack(upd.extdata);
+      }
+    }
   }
 }
 
@@ -48,7 +144,7 @@ void BlockUpdateNotify::readFromMsg(InMessage &msg) {
 void BlockUpdatePlace::writeToMsg(OutMessage &msg) const {
   msg.setType(MessageType::BlockUpdate, BlockUpdateSubtype::Place);
 
-  msg.writeI32(worldId);
+  msg.writeV32(worldId);
   msg.writeIVec3(pos);
   msg.writeU16(id);
   msg.writeU16(data);
@@ -56,7 +152,7 @@ void BlockUpdatePlace::writeToMsg(OutMessage &msg) const {
 }
 
 void BlockUpdatePlace::readFromMsg(InMessage &msg) {
-  worldId = msg.readI32();
+  worldId = msg.readV32();
   pos = msg.readIVec3();
   id = msg.readU16();
   data = msg.readU16();
@@ -67,12 +163,12 @@ void BlockUpdatePlace::readFromMsg(InMessage &msg) {
 void BlockUpdateBreak::writeToMsg(OutMessage &msg) const {
   msg.setType(MessageType::BlockUpdate, BlockUpdateSubtype::Break);
 
-  msg.writeI32(worldId);
+  msg.writeV32(worldId);
   msg.writeIVec3(pos);
 }
 
 void BlockUpdateBreak::readFromMsg(InMessage &msg)  {
-  worldId = msg.readI32();
+  worldId = msg.readV32();
   pos = msg.readIVec3();
 }
 
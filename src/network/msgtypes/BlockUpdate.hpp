@@ -18,6 +18,16 @@ enum class BlockUpdateSubtype : uint8 {
   Break
 };
 
+///
+/// @brief Changed blocks, with their new state.
+/// On the wire, updates are grouped by chunk: each group has a world and chunk header, then 2
+/// bytes per update holding the block's index in the chunk and which fields follow. Fields that
+/// don't follow keep the value of the group's previous update, so that bulk edits to the same
+/// block cost little more than the index. Extdata is only sent when `updated.extdata` is set.
+///
+/// Updates always carry the block's id, data and light; `updated.id`, `updated.data` and
+/// `updated.light` are set when read.
+///
 struct BlockUpdateNotify : public MsgType {
   struct UpdateData {
     struct Updated {
@@ -9,7 +9,7 @@ void ChunkTransferRequest::writeToMsg(OutMessage &msg) const {
 
   msg.writeU8(chunks.size());
   for (const ChunkData &c : chunks) {
-    msg.writeI32(c.worldId);
+    msg.writeV32(c.worldId);
     msg.writeIVec3(c.chunkPos);
   }
 }
@@ -21,7 +21,7 @@ void ChunkTransferRequest::readFromMsg(InMessage &msg) {
   for (uint8 i  = 0; i < count; ++i) {
     chunks.emplace_back();
     ChunkData &c = chunks.back();
-    c.worldId = msg.readI32();
+    c.worldId = msg.readV32();
     c.chunkPos = msg.readIVec3();
   }
 }
@@ -32,9 +32,9 @@ void ChunkTransferResponse::writeToMsg(OutMessage &msg) const {
 
   msg.writeU8(chunks.size());
   for (const ChunkData &c : chunks) {
-    msg.writeI32(c.worldId);
+    msg.writeV32(c.worldId);
     msg.writeIVec3(c.chunkPos);
-    msg.writeU32(c.dataLength);
+    msg.writeUV32(c.dataLength);
     msg.writeData(c.data, c.dataLength);
   }
 }
@@ -46,9 +46,9 @@ void ChunkTransferResponse::readFromMsg(InMessage &msg) {
   for (uint8 i  = 0; i < count; ++i) {
     chunks.emplace_back();
     ChunkData &c = chunks.back();
-    c.worldId = msg.readI32();
+    c.worldId = msg.readV32();
     c.chunkPos = msg.readIVec3();
-    c.dataLength = msg.readU32();
+    c.dataLength = msg.readUV32();
     c.data = msg.getCursorPtr(c.dataLength);
   }
 }
@@ -1,57 +1,293 @@
 #include "PlayerUpdate.hpp"
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <glm/common.hpp>
+
+#include "../../Chunk.hpp"
+#include "../../platform/Math.hpp"
+
 namespace Diggler {
 namespace Net {
 namespace MsgTypes {
 
+using Q = MovementQuantization;
+
+static constexpr float
+  PositionScale = 1 << Q::PositionFractionBits,
+  VelocityScale = 1 << Q::VelocityFractionBits,
+  AngleScale = (1 << Q::AngleBits) / (2 * M_PI);
+// Steps in a chunk along each axis, the range of chunk-relative positions
+static constexpr int ChunkSteps[3] = {
+  Chunk::CX << Q::PositionFractionBits,
+  Chunk::CY << Q::PositionFractionBits,
+  Chunk::CZ << Q::PositionFractionBits
+};
+static_assert(ChunkSteps[0] <= 0x10000 && ChunkSteps[1] <= 0x10000 && ChunkSteps[2] <= 0x10000,
+  "Chunk-relative positions don't fit in 16 bits");
+
+static int32 quantize(float v, float scale) {
+  // Clamped short of 2^31 to keep the conversion defined
+  return static_cast<int32>(glm::clamp(std::round(v * scale), -2147483520.f, 2147483520.f));
+}
+
+static int16 quantize16(float v, float scale) {
+  return static_cast<int16>(glm::clamp(quantize(v, scale), -0x8000, 0x7FFF));
+}
+
+glm::ivec3 MovementQuantization::quantizePosition(const glm::vec3 &p) {
+  return glm::ivec3(quantize(p.x, PositionScale), quantize(p.y, PositionScale),
+    quantize(p.z, PositionScale));
+}
+
+glm::vec3 MovementQuantization::dequantizePosition(const glm::ivec3 &q) {
+  return glm::vec3(q) / PositionScale;
+}
+
+// How a quantized position is written
+enum class PositionEncoding : uint8 {
+  // v32 chunk coordinates, then u16 offsets within the chunk
+  ChunkRelative = 0,
+  // i8 or i16 difference with the baseline
+  Delta8 = 1,
+  Delta16 = 2
+};
+
+static bool fits(const glm::ivec3 &v, int min, int max) {
+  return v.x >= min && v.x <= max && v.y >= min && v.y <= max && v.z >= min && v.z <= max;
+}
+
+static void writePosition(OutMessage &msg, PositionEncoding enc, const glm::ivec3 &q) {
+  switch (enc) {
+  case PositionEncoding::ChunkRelative:
+    msg.writeIVec3(divrd(q.x, ChunkSteps[0]), divrd(q.y, ChunkSteps[1]),
+      divrd(q.z, ChunkSteps[2]));
+    for (int i = 0; i < 3; ++i) {
+      msg.writeU16(static_cast<uint16>(rmod(q[i], ChunkSteps[i])));
+    }
+    break;
+  case PositionEncoding::Delta8:
+    for (int i = 0; i < 3; ++i) {
+      msg.writeI8(static_cast<int8>(q[i]));
+    }
+    break;
+  case PositionEncoding::Delta16:
+    for (int i = 0; i < 3; ++i) {
+      msg.writeI16(static_cast<int16>(q[i]));
+    }
+    break;
+  }
+}
+
+static glm::ivec3 readPosition(InMessage &msg, PositionEncoding enc) {
+  glm::ivec3 q;
+  switch (enc) {
+  case PositionEncoding::ChunkRelative:
+    q = msg.readIVec3();
+    for (int i = 0; i < 3; ++i) {
+      // Unsigned, as bogus chunk coordinates can overflow
+      q[i] = static_cast<int>(static_cast<uint32>(q[i]) * ChunkSteps[i] + msg.readU16());
+    }
+    break;
+  case PositionEncoding::Delta8:
+    for (int i = 0; i < 3; ++i) {
+      q[i] = msg.readI8();
+    }
+    break;
+  case PositionEncoding::Delta16:
+    for (int i = 0; i < 3; ++i) {
+      q[i] = msg.readI16();
+    }
+    break;
+  default:
+    throw std::runtime_error("Bad position encoding");
+  }
+  return q;
+}
+
+static void writeVelocity(OutMessage &msg, const glm::vec3 &v) {
+  msg.writeI16(quantize16(v.x, VelocityScale));
+  msg.writeI16(quantize16(v.y, VelocityScale));
+  msg.writeI16(quantize16(v.z, VelocityScale));
+}
+
+static glm::vec3 readVelocity(InMessage &msg) {
+  const int16 x = msg.readI16(), y = msg.readI16(), z = msg.readI16();
+  return glm::vec3(x, y, z) / VelocityScale;
+}
+
+static void writeAngle(OutMessage &msg, float angle) {
+  // Wraps around
+  msg.writeU8(static_cast<uint8>(quantize(angle, AngleScale)));
+}
+
+static float readAngle(InMessage &msg) {
+  return msg.readU8() / AngleScale;
+}
+
+
 enum FieldFlags {
   PlayerSessID = 0x1,
   Position = 0x2,
   Velocity = 0x4,
-  Accel = 0x8
+  Accel = 0x8,
+  AckTick = 0x10
 };
 
 void PlayerUpdateMove::writeToMsg(OutMessage &msg) const {
   msg.setType(MessageType::PlayerUpdate, PlayerUpdateSubtype::Move);
 
-
   FieldFlags fields = static_cast<FieldFlags>(
     (plrSessId ? FieldFlags::PlayerSessID : 0) |
     (position ? FieldFlags::Position : 0) |
     (velocity ? FieldFlags::Velocity : 0) |
-    (accel ? FieldFlags::Accel : 0));
+    (accel ? FieldFlags::Accel : 0) |
+    (ackTick ? FieldFlags::AckTick : 0));
   msg.writeU8(fields);
   if (plrSessId) {
     msg.writeU32(*plrSessId);
   }
   if (position) {
-    msg.writeVec3(*position);
+    writePosition(msg, PositionEncoding::ChunkRelative, Q::quantizePosition(*position));
   }
   if (velocity) {
-    msg.writeVec3(*velocity);
+    writeVelocity(msg, *velocity);
   }
   if (accel) {
-    msg.writeVec3(*accel);
+    writeVelocity(msg, *accel);
+  }
+  writeAngle(msg, angle);
+  if (ackTick) {
+    msg.writeUV32(*ackTick);
   }
-  msg.writeFloat(angle);
 }
 
 void PlayerUpdateMove::readFromMsg(InMessage &msg) {
-
   FieldFlags fields = static_cast<FieldFlags>(msg.readU8());
   if (fields & FieldFlags::PlayerSessID) {
     plrSessId = msg.readU32();
   }
   if (fields & FieldFlags::Position) {
-    position = msg.readVec3();
+    position = Q::dequantizePosition(readPosition(msg, PositionEncoding::ChunkRelative));
   }
   if (fields & FieldFlags::Velocity) {
-    velocity = msg.readVec3();
+    velocity = readVelocity(msg);
   }
   if (fields & FieldFlags::Accel) {
-    accel = msg.readVec3();
+    accel = readVelocity(msg);
+  }
+  angle = readAngle(msg);
+  if (fields & FieldFlags::AckTick) {
+    ackTick = msg.readUV32();
+  }
+}
+
+
+enum StateFlags {
+  StateVelocity = 0x1,
+  // PositionEncoding
+  StatePositionShift = 1,
+  StatePositionMask = 0x3 << StatePositionShift
+};
+
+void PlayerUpdateSnapshot::writeToMsg(OutMessage &msg) const {
+  msg.setType(MessageType::PlayerUpdate, PlayerUpdateSubtype::Snapshot);
+
+  if (players.size() > std::numeric_limits<uint16>::max()) {
+    throw std::runtime_error("Too many players in a single snapshot");
+  }
+  std::unordered_map<Player::SessionID, const PlayerState*> basePlayers;
+  if (baselineTick != 0) {
+    if (baseline == nullptr || baseline->tick != baselineTick || tick - baselineTick > 0xFF) {
+      throw std::invalid_argument("Bad snapshot baseline");
+    }
+    basePlayers.reserve(baseline->players.size());
+    for (const PlayerState &ps : baseline->players) {
+      basePlayers.emplace(ps.plrSessId, &ps);
+    }
+  }
+  msg.writeUV32(tick);
+  msg.writeUV16(tickInterval);
+  msg.writeU8(baselineTick == 0 ? 0 : static_cast<uint8>(tick - baselineTick));
+  msg.writeUV16(static_cast<uint16>(players.size()));
+  for (const PlayerState &ps : players) {
+    glm::ivec3 qpos = Q::quantizePosition(ps.position);
+    PositionEncoding posEnc = PositionEncoding::ChunkRelative;
+    auto base = basePlayers.find(ps.plrSessId);
+    if (base != basePlayers.end()) {
+      const glm::ivec3 delta = qpos - Q::quantizePosition(base->second->position);
+      if (fits(delta, -0x80, 0x7F)) {
+        posEnc = PositionEncoding::Delta8;
+        qpos = delta;
+      } else if (fits(delta, -0x8000, 0x7FFF)) {
+        posEnc = PositionEncoding::Delta16;
+        qpos = delta;
+      }
+    }
+    const bool hasVelocity = ps.velocity != glm::vec3();
+    msg.writeU32(ps.plrSessId);
+    msg.writeU8((hasVelocity ? StateVelocity : 0) |
+      (static_cast<uint8>(posEnc) << StatePositionShift));
+    writePosition(msg, posEnc, qpos);
+    if (hasVelocity) {
+      writeVelocity(msg, ps.velocity);
+    }
+    writeAngle(msg, ps.angle);
+  }
+}
+
+void PlayerUpdateSnapshot::readFromMsg(InMessage &msg) {
+  tick = msg.readUV32();
+  tickInterval = msg.readUV16();
+  const uint8 baselineAge = msg.readU8();
+  baselineTick = baselineAge == 0 ? 0 : tick - baselineAge;
+  const uint16 count = msg.readUV16();
+  players.clear();
+  players.reserve(count);
+  for (uint16 i = 0; i < count; ++i) {
+    players.emplace_back();
+    PlayerState &ps = players.back();
+    ps.plrSessId = msg.readU32();
+    const uint8 flags = msg.readU8();
+    if (flags & ~(StateVelocity | StatePositionMask)) {
+      throw std::runtime_error("Bad player state flags");
+    }
+    const PositionEncoding posEnc =
+      static_cast<PositionEncoding>((flags & StatePositionMask) >> StatePositionShift);
+    const glm::ivec3 qpos = readPosition(msg, posEnc);
+    if (posEnc == PositionEncoding::Delta8 || posEnc == PositionEncoding::Delta16) {
+      ps.positionIsDelta = true;
+      ps.positionDelta = qpos;
+    } else {
+      ps.position = Q::dequantizePosition(qpos);
+    }
+    ps.velocity = (flags & StateVelocity) ? readVelocity(msg) : glm::vec3();
+    ps.angle = readAngle(msg);
+  }
+}
+
+bool PlayerUpdateSnapshot::applyBaseline(const PlayerUpdateSnapshot &base) {
+  std::unordered_map<Player::SessionID, const PlayerState*> basePlayers;
+  basePlayers.reserve(base.players.size());
+  for (const PlayerState &ps : base.players) {
+    basePlayers.emplace(ps.plrSessId, &ps);
+  }
+  for (PlayerState &ps : players) {
+    if (!ps.positionIsDelta) {
+      continue;
+    }
+    auto it = basePlayers.find(ps.plrSessId);
+    if (it == basePlayers.end()) {
+      return false;
+    }
+    ps.position = Q::dequantizePosition(Q::quantizePosition(it->second->position) +
+      ps.positionDelta);
+    ps.positionIsDelta = false;
   }
-  angle = msg.readFloat();
+  return true;
 }
 
 
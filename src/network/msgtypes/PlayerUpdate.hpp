@@ -1,6 +1,8 @@
 #ifndef DIGGLER_NET_MSGTYPES_PLAYER_UPDATE_HPP
 #define DIGGLER_NET_MSGTYPES_PLAYER_UPDATE_HPP
 
+#include <vector>
+
 #include <optional.hpp>
 
 #include "MsgType.hpp"
@@ -15,18 +17,82 @@ enum class PlayerUpdateSubtype : uint8 {
   Die,
   Respawn,
   ChangeTool,
-  ToolUse
+  ToolUse,
+  Snapshot
+};
+
+///
+/// @brief Fixed-point precision of movement fields.
+/// Quantized values are off by at most half a step from the original ones.
+///
+struct MovementQuantization {
+  /// Positions are in steps of 1/2^PositionFractionBits blocks, i.e. 1/64 block with an error
+  /// of at most 1/128 block.
+  constexpr static int PositionFractionBits = 6;
+  /// Velocities and accelerations are in steps of 1/2^VelocityFractionBits blocks/s, and range
+  /// between ±2^(15 - VelocityFractionBits) blocks/s.
+  constexpr static int VelocityFractionBits = 6;
+  /// Angles are in steps of 2π/2^AngleBits radians.
+  constexpr static int AngleBits = 8;
+
+  static glm::ivec3 quantizePosition(const glm::vec3&);
+  static glm::vec3 dequantizePosition(const glm::ivec3&);
 };
 
+///
+/// @brief Movement of a player, sent by clients to the server.
+/// Position is sent in fixed-point relative to its chunk, see MovementQuantization.
+///
 struct PlayerUpdateMove : public MsgType {
   std::experimental::optional<Player::SessionID> plrSessId;
   std::experimental::optional<glm::vec3> position, velocity, accel;
   float angle;
+  /// Latest PlayerUpdateSnapshot tick received, used by the server as a delta baseline.
+  std::experimental::optional<uint32> ackTick;
 
   void writeToMsg(OutMessage&) const override;
   void readFromMsg(InMessage&) override;
 };
 
+///
+/// @brief States of multiple players at a given server tick.
+/// Sent by the server once per tick to each client, with the players relevant to it.
+///
+/// Positions are sent as a delta from the player's position in a baseline snapshot the client
+/// acknowledged, if any, or else in fixed-point relative to their chunk.
+///
+struct PlayerUpdateSnapshot : public MsgType {
+  /// Number of snapshots each side keeps around as potential baselines.
+  constexpr static size_t BaselineHistory = 32;
+
+  struct PlayerState {
+    Player::SessionID plrSessId;
+    glm::vec3 position, velocity;
+    float angle;
+    /// Set by readFromMsg when `positionDelta` is yet to be applied to the baseline's position.
+    bool positionIsDelta = false;
+    glm::ivec3 positionDelta;
+  };
+  /// Server tick number, increasing by one every `tickInterval`.
+  uint32 tick;
+  /// Duration of a server tick, in milliseconds.
+  uint16 tickInterval;
+  /// Tick of the baseline snapshot, at most 255 ticks before `tick`. 0 if there is none.
+  uint32 baselineTick = 0;
+  std::vector<PlayerState> players;
+  /// Snapshot to delta-encode positions against when writing, with tick `baselineTick`.
+  const PlayerUpdateSnapshot *baseline = nullptr;
+
+  void writeToMsg(OutMessage&) const override;
+  void readFromMsg(InMessage&) override;
+
+  ///
+  /// @brief Makes delta-encoded positions read from a message absolute.
+  /// @returns `false` if a player whose position is a delta isn't in the baseline.
+  ///
+  bool applyBaseline(const PlayerUpdateSnapshot &baseline);
+};
+
 struct PlayerUpdateDie : public MsgType {
   Player::SessionID plrSessId;
 
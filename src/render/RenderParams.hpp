@@ -2,6 +2,7 @@
 #define DIGGLER_RENDER_RENDER_PARAMS_HPP
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 
 #include "../Frustum.hpp"
 #include "../World.hpp"
@@ -13,6 +14,7 @@ class RenderParams {
 public:
   glm::mat4 transform;
   Frustum frustum;
+  glm::vec3 cameraPos;
 
   World *world;
 };
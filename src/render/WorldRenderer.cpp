@@ -0,0 +1,33 @@
+#include "WorldRenderer.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "../FrameProfiler.hpp"
+
+namespace Diggler {
+namespace Render {
+
+static_assert(FrameStats::LodLevels == Chunk::LodLevels,
+  "FrameStats doesn't count draws at every level of detail");
+
+void WorldRenderer::rebuildQueued(float timeBudget, uint64 uploadBudget) {
+  using Clock = std::chrono::steady_clock;
+  if (m_rebuildQueue.empty()) {
+    return;
+  }
+  std::sort(m_rebuildQueue.begin(), m_rebuildQueue.end(),
+    [](const DrawItem &a, const DrawItem &b) { return a.distance < b.distance; });
+  const Clock::time_point deadline = Clock::now() +
+    std::chrono::microseconds(static_cast<int64>(timeBudget * 1000));
+  const uint64 uploadLimit = m_uploadedBytes + uploadBudget;
+  for (const DrawItem &di : m_rebuildQueue) {
+    di.chunk->updateClientLod(di.lod);
+    if (Clock::now() >= deadline || m_uploadedBytes >= uploadLimit)
+      break;
+  }
+  m_rebuildQueue.clear();
+}
+
+}
+}
@@ -1,6 +1,8 @@
 #ifndef DIGGLER_RENDER_WORLD_RENDERER_HPP
 #define DIGGLER_RENDER_WORLD_RENDERER_HPP
 
+#include <vector>
+
 #include "RenderParams.hpp"
 #include "../World.hpp"
 
@@ -16,7 +18,41 @@ protected:
     c->rendererData = data;
   }
 
+  struct DrawItem {
+    float distance;
+    Chunk *chunk;
+    uint8 lod;
+  };
+
+  /// Chunks in view whose mesh is outdated. Their previous mesh keeps being drawn until they
+  /// get rebuilt.
+  std::vector<DrawItem> m_rebuildQueue;
+  /// Vertex and index bytes passed to updateChunk() so far, to be updated by implementations.
+  uint64 m_uploadedBytes;
+
+  /**
+   * @brief Rebuilds queued chunks nearest first, until either budget is exhausted.
+   * The nearest chunk is always rebuilt, so that streaming in never stalls entirely.
+   * @param timeBudget Maximum time spent rebuilding, in milliseconds.
+   * @param uploadBudget Maximum mesh data uploaded, in bytes.
+   */
+  void rebuildQueued(float timeBudget, uint64 uploadBudget);
+
 public:
+  /**
+   * @brief Picks the level of detail to draw a Chunk with.
+   * @param distance Distance from the camera to the Chunk's center.
+   * @param lodDistance Distance at which level 1 starts, each next level starting twice as far.
+   * @return Level of detail, between 0 and Chunk::LodLevels - 1.
+   */
+  static uint8 selectLod(float distance, float lodDistance) {
+    uint8 lod = 0;
+    for (float d = lodDistance; lod < Chunk::LodLevels - 1 && distance >= d; d *= 2) {
+      ++lod;
+    }
+    return lod;
+  }
+
   struct PointedHighlight {
     virtual ~PointedHighlight() {}
     virtual void setVisible(bool) = 0;
@@ -25,16 +61,22 @@ public:
   } &pointedHighlight;
 
   WorldRenderer(PointedHighlight &ph) :
+    m_uploadedBytes(0),
     pointedHighlight(ph) {
   }
   virtual ~WorldRenderer() = 0;
 
   virtual void registerChunk(Chunk*) = 0;
-  virtual void updateChunk(Chunk*, Chunk::Vertex *vertices, uint vertCount, uint16 *indicesOpq,
-    uint idxOpqCount, uint16 *indicesTpt, uint idxTptCount) = 0;
+  virtual void updateChunk(Chunk*, uint8 lod, const Chunk::MeshView&) = 0;
   virtual void unregisterChunk(Chunk*) = 0;
 
   virtual void render(RenderParams&) = 0;
+
+  ///
+  /// @brief Draws transparent geometry of the chunks drawn by the last render() call.
+  /// Meant to be called after all opaque geometry of the frame has been drawn.
+  ///
+  virtual void renderTransparent(RenderParams&) = 0;
 };
 
 inline WorldRenderer::~WorldRenderer() {}
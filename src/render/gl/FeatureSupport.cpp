@@ -17,7 +17,8 @@ bool
   F::DSA,
   F::shader_image_load_store,
   F::FBO_ARB,
-  F::buffer_storage;
+  F::buffer_storage,
+  F::draw_elements_base_vertex;
 
 void F::probe() {
   VAO = OpenGL::hasExtension("GL_ARB_vertex_array_object") or
@@ -28,6 +29,7 @@ void F::probe() {
   shader_image_load_store = OpenGL::hasExtension("GL_ARB_shader_image_load_store");
   FBO_ARB = OpenGL::hasExtension("GL_ARB_framebuffer_object");
   buffer_storage = OpenGL::hasExtension("GL_ARB_buffer_storage");
+  draw_elements_base_vertex = OpenGL::hasExtension("GL_ARB_draw_elements_base_vertex");
 }
 
 #define feature(x) if(x){oss<<#x<<std::endl;}
@@ -40,6 +42,7 @@ std::string F::supported() {
   feature(shader_image_load_store);
   feature(FBO_ARB);
   feature(buffer_storage);
+  feature(draw_elements_base_vertex);
   return oss.str();
 }
 #undef feature
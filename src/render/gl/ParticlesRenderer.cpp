@@ -61,6 +61,8 @@ void GLParticlesRenderer::render(RenderParams &rp) {
   glUniform4f(uni_unicolor, 1.f, 1.f, 1.f, 1.f);
 
   for (ParticleEmitter &pe : rp.world->emitters) {
+    if (pe.getMaxCount() == 0 || !rp.frustum.boxInFrustum(pe.getBounds()))
+      continue;
     EmitterRenderData &rd = *reinterpret_cast<EmitterRenderData*>(getRendererData(pe));
     rd.vao.bind();
     glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(pe.getMaxCount()));
@@ -1,13 +1,17 @@
 #include "WorldRenderer.hpp"
 
+#include <algorithm>
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "../../content/Registry.hpp"
 #include "../../Chunk.hpp"
+#include "../../FrameProfiler.hpp"
 #include "../../Game.hpp"
 #include "../../World.hpp"
+#include "FeatureSupport.hpp"
 #include "ProgramManager.hpp"
 
 namespace Diggler {
@@ -18,7 +22,9 @@ using GLCoord = Chunk::Vertex;
 
 GLWorldRenderer::GLWorldRenderer(Game *G) :
   WorldRenderer(pointedHighlight),
-  G(G) {
+  G(G),
+  m_useArena(G->RP->sharedChunkBuffers && FeatureSupport::VAO &&
+    FeatureSupport::draw_elements_base_vertex) {
   loadShader();
 }
 
@@ -48,92 +54,348 @@ void GLWorldRenderer::registerChunk(Chunk *c) {
   }
   ChunkEntry &ce = *(new ChunkEntry);
   setRendererData(c, reinterpret_cast<uintptr_t>(&ce));
-  { VAO::Config cfg = ce.vao.configure();
-    cfg.vertexAttrib(ce.vbo, att_coord, 3, GL_FLOAT, sizeof(GLCoord), 0);
-    //cfg.vertexAttrib(ce.vbo, att_wave, 1, GL_BYTE, sizeof(GLCoord), offsetof(GLCoord, w));
-    cfg.vertexAttrib(ce.vbo, att_texcoord, 2, GL_UNSIGNED_SHORT, sizeof(GLCoord),
-      offsetof(GLCoord, tx), true);
-    cfg.vertexAttrib(ce.vbo, att_color, 3, GL_FLOAT, sizeof(GLCoord), offsetof(GLCoord, r));
-    cfg.elementArrayBuffer(ce.ibo);
-    cfg.commit();
+  m_frustumCuller.add(c);
+  if (!m_useArena) {
+    getMesh(ce, 0);
+  }
+}
+
+void GLWorldRenderer::configureVAO(VAO &vao, const VBO &vbo, const VBO &ibo) {
+  VAO::Config cfg = vao.configure();
+  cfg.vertexAttrib(vbo, att_coord, 3, GL_FLOAT, sizeof(GLCoord), 0);
+  //cfg.vertexAttrib(vbo, att_wave, 1, GL_BYTE, sizeof(GLCoord), offsetof(GLCoord, w));
+  cfg.vertexAttrib(vbo, att_texcoord, 2, GL_UNSIGNED_SHORT, sizeof(GLCoord),
+    offsetof(GLCoord, tx), true);
+  cfg.vertexAttrib(vbo, att_color, 3, GL_FLOAT, sizeof(GLCoord), offsetof(GLCoord, r));
+  cfg.elementArrayBuffer(ibo);
+  cfg.commit();
+}
+
+GLWorldRenderer::ChunkMesh& GLWorldRenderer::getMesh(ChunkEntry &ce, uint8 lod) {
+  if (ce.lods[lod]) {
+    return *ce.lods[lod];
+  }
+  ce.lods[lod] = std::make_unique<ChunkMesh>();
+  ChunkMesh &cm = *ce.lods[lod];
+  cm.vertCount = cm.indicesOpq = cm.indicesTpt = 0;
+  cm.indexType = GL_UNSIGNED_SHORT;
+  configureVAO(cm.vao, cm.vbo, cm.ibo);
+  return cm;
+}
+
+GLWorldRenderer::ArenaPage::ArenaPage(uint vertexCapacity, uint indexCapacity) :
+  vertices(vertexCapacity),
+  indices(indexCapacity) {
+  vbo.resize(vertexCapacity * sizeof(GLCoord), GL_DYNAMIC_DRAW);
+  ibo.resize(indexCapacity, GL_DYNAMIC_DRAW);
+}
+
+void GLWorldRenderer::freeArenaMesh(ArenaMesh &am) {
+  if (am.page) {
+    am.page->vertices.free(am.baseVertex, am.vertCount);
+    am.page->indices.free(am.indexOffset, am.indexBytes);
+    am.page = nullptr;
+  }
+}
+
+void GLWorldRenderer::updateArenaMesh(Chunk *c, ArenaMesh &am, const Chunk::MeshView &mesh) {
+  using Alloc = Util::FreeListAllocator;
+  freeArenaMesh(am);
+  am.built = true;
+  if (mesh.vertCount == 0) {
+    return;
+  }
+  const uint opqSize = mesh.indexSize * mesh.idxOpqCount,
+    tptSize = mesh.indexSize * mesh.idxTptCount;
+  ArenaPage *page = nullptr;
+  Alloc::Offset baseVertex = Alloc::InvalidOffset, indexOffset = Alloc::InvalidOffset;
+  for (std::unique_ptr<ArenaPage> &p : m_pages) {
+    baseVertex = p->vertices.allocate(mesh.vertCount);
+    if (baseVertex == Alloc::InvalidOffset) {
+      continue;
+    }
+    indexOffset = p->indices.allocate(opqSize + tptSize, sizeof(uint32));
+    if (indexOffset == Alloc::InvalidOffset) {
+      p->vertices.free(baseVertex, mesh.vertCount);
+      continue;
+    }
+    page = p.get();
+    break;
+  }
+  if (!page) {
+    m_pages.emplace_back(std::make_unique<ArenaPage>(
+      std::max(uint(ArenaPageVertices), mesh.vertCount),
+      std::max(uint(ArenaPageIndexBytes), opqSize + tptSize)));
+    page = m_pages.back().get();
+    configureVAO(page->vao, page->vbo, page->ibo);
+    baseVertex = page->vertices.allocate(mesh.vertCount);
+    indexOffset = page->indices.allocate(opqSize + tptSize, sizeof(uint32));
   }
+
+  // All chunks of a multi-draw share the same transform, so vertices are moved to world space
+  // here rather than with a per-chunk uniform.
+  const glm::ivec3 origin = c->getWorldChunkPos() * glm::ivec3(Chunk::CX, Chunk::CY, Chunk::CZ);
+  m_staging.assign(mesh.vertices, mesh.vertices + mesh.vertCount);
+  for (GLCoord &v : m_staging) {
+    v.x += origin.x;
+    v.y += origin.y;
+    v.z += origin.z;
+  }
+  page->vbo.setSubData(m_staging.data(), baseVertex, mesh.vertCount);
+  page->ibo.setSubData(static_cast<const uint8*>(mesh.indicesOpq), indexOffset, opqSize);
+  page->ibo.setSubData(static_cast<const uint8*>(mesh.indicesTpt), indexOffset + opqSize, tptSize);
+
+  am.page = page;
+  am.baseVertex = baseVertex;
+  am.vertCount = mesh.vertCount;
+  am.indexOffset = indexOffset;
+  am.indexBytes = opqSize + tptSize;
+  am.indicesOpq = mesh.idxOpqCount;
+  am.indicesTpt = mesh.idxTptCount;
+  am.indexType = mesh.indexSize == sizeof(uint32) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
 }
 
-void GLWorldRenderer::updateChunk(Chunk *c, Chunk::Vertex *vertices, uint vertCount,
-  uint16 *indicesOpq, uint idxOpqCount, uint16 *indicesTpt, uint idxTptCount) {
+void GLWorldRenderer::updateChunk(Chunk *c, uint8 lod, const Chunk::MeshView &mesh) {
   ChunkEntry &ce = *reinterpret_cast<ChunkEntry*>(getRendererData(c));
-  ce.vbo.setDataGrow(vertices, vertCount, GL_DYNAMIC_DRAW);
-  ce.ibo.resizeGrow(sizeof(uint16) * (idxOpqCount + idxTptCount), GL_DYNAMIC_DRAW);
-  ce.ibo.setSubData(indicesOpq, 0, idxOpqCount);
-  ce.ibo.setSubData(indicesTpt, idxOpqCount, idxTptCount);
-  ce.indicesOpq = idxOpqCount;
-  ce.indicesTpt = idxTptCount;
+  const uint64 bytes = mesh.vertCount * sizeof(Chunk::Vertex) +
+    (mesh.idxOpqCount + mesh.idxTptCount) * mesh.indexSize;
+  m_uploadedBytes += bytes;
+  FrameStats &fs = G->FP->current();
+  ++fs.meshesRebuilt;
+  fs.bytesUploaded += bytes;
+  if (m_useArena) {
+    updateArenaMesh(c, ce.arenaLods[lod], mesh);
+    return;
+  }
+  ChunkMesh &cm = getMesh(ce, lod);
+  cm.vbo.setDataGrow(mesh.vertices, mesh.vertCount, GL_DYNAMIC_DRAW);
+  const uint opqSize = mesh.indexSize * mesh.idxOpqCount,
+    tptSize = mesh.indexSize * mesh.idxTptCount;
+  cm.ibo.resizeGrow(opqSize + tptSize, GL_DYNAMIC_DRAW);
+  cm.ibo.setSubData(static_cast<const uint8*>(mesh.indicesOpq), 0, opqSize);
+  cm.ibo.setSubData(static_cast<const uint8*>(mesh.indicesTpt), opqSize, tptSize);
+  cm.indexType = mesh.indexSize == sizeof(uint32) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+  cm.vertCount = mesh.vertCount;
+  cm.indicesOpq = mesh.idxOpqCount;
+  cm.indicesTpt = mesh.idxTptCount;
 }
 
 void GLWorldRenderer::unregisterChunk(Chunk *c) {
   if (c == nullptr) {
     return;
   }
-  delete reinterpret_cast<ChunkEntry*>(getRendererData(c));
+  m_frustumCuller.remove(c);
+  ChunkEntry *ce = reinterpret_cast<ChunkEntry*>(getRendererData(c));
+  for (ArenaMesh &am : ce->arenaLods) {
+    freeArenaMesh(am);
+  }
+  delete ce;
 }
 
-void GLWorldRenderer::render(RenderParams &rp) {
-  if (prog == nullptr)
+void GLWorldRenderer::drawArenaRun(ArenaPage &p, int wide) {
+  ArenaPage::DrawList &dl = p.draws[wide];
+  if (dl.counts.empty()) {
     return;
-  //lastVertCount = 0;
+  }
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, dl.counts.data(),
+    wide == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, dl.offsets.data(),
+    static_cast<GLsizei>(dl.counts.size()), dl.baseVertices.data());
+  ++G->FP->current().drawCalls;
+  dl.counts.clear();
+  dl.offsets.clear();
+  dl.baseVertices.clear();
+}
+
+void GLWorldRenderer::drawArenaPages() {
+  for (std::unique_ptr<ArenaPage> &p : m_pages) {
+    if (p->draws[0].counts.empty() && p->draws[1].counts.empty()) {
+      continue;
+    }
+    // Regroups the list by page and index type, so only fit for order-independent draws
+    p->vao.bind();
+    drawArenaRun(*p, 0);
+    drawArenaRun(*p, 1);
+    p->vao.unbind();
+  }
+}
+
+bool GLWorldRenderer::meshIndices(const ChunkEntry &ce, uint8 lod, uint &opq, uint &tpt) const {
+  opq = tpt = 0;
+  if (m_useArena) {
+    const ArenaMesh &am = ce.arenaLods[lod];
+    if (am.page) {
+      opq = am.indicesOpq;
+      tpt = am.indicesTpt;
+    }
+    return am.built;
+  }
+  if (const ChunkMesh *cm = ce.lods[lod].get()) {
+    opq = cm->indicesOpq;
+    tpt = cm->indicesTpt;
+    return true;
+  }
+  return false;
+}
+
+void GLWorldRenderer::buildRenderLists(const RenderParams &rp, bool occlusion) {
+  const static glm::vec3 cShift(Chunk::MidX, Chunk::MidY, Chunk::MidZ);
+  m_candidates.clear();
+  for (Chunk *c : m_visibleChunks) {
+    if (c->W.get() != rp.world)
+      continue;
+    if (occlusion && !m_occlusionCuller.isVisible(*c))
+      continue;
+    const glm::vec3 center = glm::vec3(c->wcx * Chunk::CX, c->wcy * Chunk::CY,
+      c->wcz * Chunk::CZ) + cShift;
+    const float distance = glm::distance(center, rp.cameraPos);
+    const uint8 lod = selectLod(distance, G->RP->lodDistance);
+    if (c->isDirty(lod))
+      m_rebuildQueue.push_back({ distance, c, lod });
+    m_candidates.push_back({ distance, c, lod });
+  }
+  FrameStats &fs = G->FP->current();
+  { FrameProfiler::Scope scope(fs, FrameStats::Phase::Meshing);
+    rebuildQueued(G->RP->chunkRebuildBudget, G->RP->chunkUploadBudget);
+  }
+
+  m_opaqueList.clear();
+  m_transparentList.clear();
+  for (DrawItem di : m_candidates) {
+    const ChunkEntry &ce = *reinterpret_cast<ChunkEntry*>(getRendererData(di.chunk));
+    uint indicesOpq, indicesTpt;
+    if (!meshIndices(ce, di.lod, indicesOpq, indicesTpt)) {
+      // Level not built yet, stand in with the closest one that is
+      for (int d = 1; d < Chunk::LodLevels; ++d) {
+        if (di.lod >= d && meshIndices(ce, di.lod - d, indicesOpq, indicesTpt)) {
+          di.lod -= d;
+          break;
+        }
+        if (di.lod + d < Chunk::LodLevels && meshIndices(ce, di.lod + d, indicesOpq, indicesTpt)) {
+          di.lod += d;
+          break;
+        }
+      }
+    }
+    if (indicesOpq)
+      m_opaqueList.push_back(di);
+    if (indicesTpt)
+      m_transparentList.push_back(di);
+    if (indicesOpq || indicesTpt) {
+      ++fs.chunksDrawn;
+      ++fs.lodChunksDrawn[di.lod];
+    }
+  }
+  fs.chunksConsidered += m_frustumCuller.stats.chunksCulled + m_frustumCuller.stats.chunksVisible;
+  fs.chunksCulled += m_frustumCuller.stats.chunksCulled +
+    (m_frustumCuller.stats.chunksVisible - m_candidates.size());
+  std::sort(m_opaqueList.begin(), m_opaqueList.end(),
+    [](const DrawItem &a, const DrawItem &b) { return a.distance < b.distance; });
+  std::sort(m_transparentList.begin(), m_transparentList.end(),
+    [](const DrawItem &a, const DrawItem &b) { return a.distance > b.distance; });
+}
+
+void GLWorldRenderer::bindState() {
+  // Every chunk uses the same program and block atlas, bound once per pass
   prog->bind();
   glUniform1f(uni_fogStart, G->RP->fogStart);
   glUniform1f(uni_fogEnd, G->RP->fogEnd);
   glUniform1f(uni_time, G->Time);
   G->CR->getAtlas()->bind();
+}
 
-  const static glm::vec3 cShift(Chunk::MidX, Chunk::MidY, Chunk::MidZ);
-  glm::mat4 chunkTransform;
-  ChunkRef c;
-  for (auto pair : *rp.world) {
-    const glm::ivec3 &pos = pair.first;
-    ChunkWeakRef &cwr = pair.second;
-    if ((c = cwr.lock())) {
-#if CHUNK_INMEM_COMPRESS
-      if (!c->imcData && (G->TimeMs - c->imcUnusedSince) > CHUNK_INMEM_COMPRESS_DELAY)
-        c->imcCompress();
-#endif
-      ChunkEntry &ce = *reinterpret_cast<ChunkEntry*>(getRendererData(c.get()));
-      glm::vec3 translate(pos.x * Chunk::CX, pos.y * Chunk::CY, pos.z * Chunk::CZ);
-      if (rp.frustum.sphereInFrustum(translate + cShift, Chunk::CullSphereRadius)) {
-        chunkTransform = glm::translate(rp.transform, translate);
-#if SHOW_CHUNK_UPDATES
-        glUniform4f(uni_unicolor, 1.f, dirty ? 0.f : 1.f, dirty ? 0.f : 1.f, 1.f);
-#endif
-        if (c->isDirty())
-          c->updateClient();
-        if (!ce.indicesOpq)
-          continue;
-
-        glUniformMatrix4fv(uni_mvp, 1, GL_FALSE, glm::value_ptr(chunkTransform));
-        ce.vao.bind();
-        glDrawElements(GL_TRIANGLES, ce.indicesOpq, GL_UNSIGNED_SHORT, nullptr);
-        ce.vao.unbind();
-        //lastVertCount += cc->vertices;
+void GLWorldRenderer::drawList(const std::vector<DrawItem> &list, bool transparent,
+  const RenderParams &rp) {
+  FrameStats &fs = G->FP->current();
+  FrameProfiler::Scope scope(fs, FrameStats::Phase::Draw);
+  if (m_useArena) {
+    glUniformMatrix4fv(uni_mvp, 1, GL_FALSE, glm::value_ptr(rp.transform));
+    // Blending needs transparent chunks drawn in the list's back-to-front order, so they are
+    // only batched while consecutive ones share a page and index type
+    ArenaPage *runPage = nullptr;
+    int runWide = 0;
+    for (const DrawItem &di : list) {
+      const ArenaMesh &am = reinterpret_cast<ChunkEntry*>(getRendererData(di.chunk))->
+        arenaLods[di.lod];
+      const int wide = am.indexType == GL_UNSIGNED_INT ? 1 : 0;
+      if (transparent && (am.page != runPage || wide != runWide)) {
+        if (runPage) {
+          drawArenaRun(*runPage, runWide);
+        }
+        am.page->vao.bind();
+        runPage = am.page;
+        runWide = wide;
+      }
+      const uint indexSize = wide ? sizeof(uint32) : sizeof(uint16);
+      ArenaPage::DrawList &dl = am.page->draws[wide];
+      dl.counts.push_back(transparent ? am.indicesTpt : am.indicesOpq);
+      fs.triangles += dl.counts.back() / 3;
+      dl.offsets.push_back(reinterpret_cast<const GLvoid*>(uintptr_t(am.indexOffset +
+        (transparent ? am.indicesOpq * indexSize : 0))));
+      dl.baseVertices.push_back(am.baseVertex);
+    }
+    if (transparent) {
+      if (runPage) {
+        drawArenaRun(*runPage, runWide);
+        runPage->vao.unbind();
       }
+    } else {
+      drawArenaPages();
     }
+    return;
+  }
+  const VAO *bound = nullptr;
+  for (const DrawItem &di : list) {
+    const ChunkMesh &cm = *reinterpret_cast<ChunkEntry*>(getRendererData(di.chunk))->
+      lods[di.lod];
+    const Chunk &c = *di.chunk;
+    const glm::mat4 chunkTransform = glm::translate(rp.transform,
+      glm::vec3(c.wcx * Chunk::CX, c.wcy * Chunk::CY, c.wcz * Chunk::CZ));
+    const uint indexSize = cm.indexType == GL_UNSIGNED_INT ? sizeof(uint32) : sizeof(uint16);
+    glUniformMatrix4fv(uni_mvp, 1, GL_FALSE, glm::value_ptr(chunkTransform));
+    // Leave the VAO bound until the next chunk's replaces it
+    cm.vao.bind();
+    bound = &cm.vao;
+    const uint count = transparent ? cm.indicesTpt : cm.indicesOpq;
+    glDrawElements(GL_TRIANGLES, count, cm.indexType,
+      reinterpret_cast<const GLvoid*>(uintptr_t(transparent ? cm.indicesOpq * indexSize : 0)));
+    ++fs.drawCalls;
+    fs.triangles += count / 3;
+  }
+  if (bound) {
+    bound->unbind();
   }
 }
 
-/*void GLWorldRenderer::renderTransparent(RenderParams &rp) {
-  if (!indicesTpt)
+void GLWorldRenderer::render(RenderParams &rp) {
+  if (prog == nullptr)
     return;
+#if CHUNK_INMEM_COMPRESS
+  m_frustumCuller.forEach([this](Chunk &c) {
+    if (!c.imcData && (G->TimeMs - c.imcUnusedSince) > CHUNK_INMEM_COMPRESS_DELAY)
+      c.imcCompress();
+  });
+#endif
+  bool occlusion;
+  { FrameProfiler::Scope scope(G->FP->current(), FrameStats::Phase::Culling);
+    occlusion = G->RP->occlusionCulling &&
+      m_occlusionCuller.run(*rp.world, rp.cameraPos, rp.frustum);
+    m_visibleChunks.clear();
+    m_frustumCuller.cull(rp.frustum, m_visibleChunks);
+  }
+  buildRenderLists(rp, occlusion);
 
-  // Here we really need to pass the matrix again since the call is made in a second render pass
-  glUniformMatrix4fv(uni_mvp, 1, GL_FALSE, glm::value_ptr(transform));
-  vbo->bind();
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo->id());
-  glVertexAttribPointer(att_coord, 3, GL_BYTE, GL_FALSE, sizeof(GLCoord), 0);
-  glVertexAttribPointer(att_wave, 1, GL_BYTE, GL_TRUE, sizeof(GLCoord), (GLvoid*)offsetof(GLCoord, w));
-  glVertexAttribPointer(att_texcoord, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GLCoord), (GLvoid*)offsetof(GLCoord, tx));
-  glVertexAttribPointer(att_color, 3, GL_FLOAT, GL_FALSE, sizeof(GLCoord), (GLvoid*)offsetof(GLCoord, r));
-  glDrawElements(GL_TRIANGLES, indicesTpt, GL_UNSIGNED_SHORT, (GLvoid*)(indicesOpq*sizeof(GLshort)));
-}*/
+  bindState();
+  drawList(m_opaqueList, false, rp);
+}
+
+void GLWorldRenderer::renderTransparent(RenderParams &rp) {
+  if (prog == nullptr || m_transparentList.empty())
+    return;
+  bindState();
+  glDepthMask(GL_FALSE);
+  drawList(m_transparentList, true, rp);
+  glDepthMask(GL_TRUE);
+}
 
 void GLWorldRenderer::PointedHighlight::setVisible(bool visible) {
   this->visible = visible;
@@ -3,8 +3,12 @@
 
 #include "../WorldRenderer.hpp"
 
+#include <memory>
 #include <vector>
 
+#include "../../ChunkFrustumCuller.hpp"
+#include "../../ChunkVisibility.hpp"
+#include "../../util/FreeListAllocator.hpp"
 #include "Program.hpp"
 #include "VAO.hpp"
 #include "VBO.hpp"
@@ -30,14 +34,66 @@ protected:
           uni_fogEnd,
           uni_time;
 
-  struct ChunkEntry {
+  struct ChunkMesh {
     VAO vao;
     VBO vbo, ibo;
     uint vertCount, indicesOpq, indicesTpt;
+    GLenum indexType;
+  };
+
+  // Shared buffers mode: chunk meshes are sub-allocated from a few large pages, each drawn with
+  // one glMultiDrawElementsBaseVertex per index type.
+  constexpr static uint
+    ArenaPageVertices = 1 << 18,
+    ArenaPageIndexBytes = ArenaPageVertices * 3; /* 6 16-bit indices per 4 vertices */
+  struct ArenaPage {
+    VAO vao;
+    VBO vbo, ibo;
+    Util::FreeListAllocator vertices /* in vertices */, indices /* in bytes */;
+    // Current pass' draws, for 16 then 32-bit indices
+    struct DrawList {
+      std::vector<GLsizei> counts;
+      std::vector<const GLvoid*> offsets;
+      std::vector<GLint> baseVertices;
+    } draws[2];
+
+    ArenaPage(uint vertexCapacity, uint indexCapacity);
+  };
+  struct ArenaMesh {
+    ArenaPage *page = nullptr;
+    bool built = false;
+    uint32 baseVertex, vertCount, indexOffset, indexBytes;
+    uint indicesOpq, indicesTpt;
+    GLenum indexType;
+  };
+  const bool m_useArena;
+  ChunkFrustumCuller m_frustumCuller;
+  ChunkOcclusionCuller m_occlusionCuller;
+  std::vector<Chunk*> m_visibleChunks;
+
+  // Render lists, rebuilt every frame: opaque geometry front-to-back for early depth rejection,
+  // transparent geometry back-to-front for blending
+  std::vector<DrawItem> m_candidates, m_opaqueList, m_transparentList;
+  std::vector<std::unique_ptr<ArenaPage>> m_pages;
+  std::vector<Chunk::Vertex> m_staging;
+
+  struct ChunkEntry {
+    // Levels of detail are allocated on first use, most chunks only ever use one or two
+    std::unique_ptr<ChunkMesh> lods[Chunk::LodLevels];
+    ArenaMesh arenaLods[Chunk::LodLevels];
   };
-  std::vector<ChunkEntry> m_chunks;
 
   void loadShader();
+  void configureVAO(VAO&, const VBO &vbo, const VBO &ibo);
+  ChunkMesh& getMesh(ChunkEntry&, uint8 lod);
+  void updateArenaMesh(Chunk*, ArenaMesh&, const Chunk::MeshView&);
+  void freeArenaMesh(ArenaMesh&);
+  void drawArenaRun(ArenaPage&, int wide);
+  void drawArenaPages();
+  bool meshIndices(const ChunkEntry&, uint8 lod, uint &opq, uint &tpt) const;
+  void buildRenderLists(const RenderParams&, bool occlusion);
+  void bindState();
+  void drawList(const std::vector<DrawItem>&, bool transparent, const RenderParams&);
 
 public:
   struct PointedHighlight : public WorldRenderer::PointedHighlight {
@@ -54,11 +110,15 @@ public:
   ~GLWorldRenderer();
 
   void registerChunk(Chunk*);
-  void updateChunk(Chunk*, Chunk::Vertex *vertices, uint vertCount, uint16 *indicesOpq,
-    uint idxOpqCount, uint16 *indicesTpt, uint idxTptCount);
+  void updateChunk(Chunk*, uint8 lod, const Chunk::MeshView&);
   void unregisterChunk(Chunk*);
 
   void render(RenderParams&);
+  void renderTransparent(RenderParams&);
+
+  const ChunkFrustumCuller::Stats& frustumCullingStats() const {
+    return m_frustumCuller.stats;
+  }
 };
 
 }
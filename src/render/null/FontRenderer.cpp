@@ -0,0 +1,40 @@
+#include "FontRenderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+NullFontRenderer::NullTextBuffer::NullTextBuffer() :
+  vertexCount(0) {
+}
+
+NullFontRenderer::NullTextBuffer::~NullTextBuffer() {
+}
+
+NullFontRenderer::NullFontRenderer() {
+}
+
+NullFontRenderer::~NullFontRenderer() {
+}
+
+NullFontRenderer::TextBufferRef NullFontRenderer::createTextBuffer(FontRendererTextBufferUsage) {
+  return std::make_unique<NullTextBuffer>();
+}
+
+void NullFontRenderer::registerFont(UI::Font&) {
+}
+
+void NullFontRenderer::unregisterFont(UI::Font&) {
+}
+
+void NullFontRenderer::updateTextBuffer(TextBufferRef &buf, const TextBuffer::Vertex*,
+    uint vertexCount) {
+  reinterpret_cast<NullTextBuffer*>(buf.get())->vertexCount = vertexCount;
+}
+
+void NullFontRenderer::render(const UI::Font&, const TextBufferRef&, const glm::mat4&) {
+}
+
+}
+}
+}
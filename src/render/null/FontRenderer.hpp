@@ -0,0 +1,37 @@
+#ifndef DIGGLER_RENDER_NULL_FONT_RENDERER_HPP
+#define DIGGLER_RENDER_NULL_FONT_RENDERER_HPP
+
+#include "../FontRenderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+class NullFontRenderer : public FontRenderer {
+public:
+  class NullTextBuffer : public TextBuffer {
+  public:
+    uint vertexCount;
+
+    NullTextBuffer();
+    ~NullTextBuffer() final override;
+  };
+
+  NullFontRenderer();
+  ~NullFontRenderer();
+
+  void registerFont(UI::Font&) final override;
+  void unregisterFont(UI::Font&) final override;
+
+  TextBufferRef createTextBuffer(FontRendererTextBufferUsage) final override;
+  void updateTextBuffer(TextBufferRef&, const TextBuffer::Vertex *vertices,
+      uint vertexCount) final override;
+
+  void render(const UI::Font&, const TextBufferRef&, const glm::mat4&) final override;
+};
+
+}
+}
+}
+
+#endif /* DIGGLER_RENDER_NULL_FONT_RENDERER_HPP */
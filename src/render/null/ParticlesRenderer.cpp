@@ -0,0 +1,28 @@
+#include "ParticlesRenderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+NullParticlesRenderer::NullParticlesRenderer() {
+}
+
+NullParticlesRenderer::~NullParticlesRenderer() {
+}
+
+void NullParticlesRenderer::registerEmitter(ParticleEmitter&) {
+}
+
+void NullParticlesRenderer::updateParticleData(ParticleEmitter&,
+  ParticleEmitter::ParticleRenderData*, size_t) {
+}
+
+void NullParticlesRenderer::unregisterEmitter(ParticleEmitter&) {
+}
+
+void NullParticlesRenderer::render(RenderParams&) {
+}
+
+}
+}
+}
@@ -0,0 +1,27 @@
+#ifndef DIGGLER_RENDER_NULL_PARTICLES_RENDERER_HPP
+#define DIGGLER_RENDER_NULL_PARTICLES_RENDERER_HPP
+
+#include "../ParticlesRenderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+class NullParticlesRenderer : public ParticlesRenderer {
+public:
+  NullParticlesRenderer();
+  ~NullParticlesRenderer();
+
+  void registerEmitter(ParticleEmitter&) final override;
+  void updateParticleData(ParticleEmitter&, ParticleEmitter::ParticleRenderData *data,
+      size_t count) final override;
+  void unregisterEmitter(ParticleEmitter&) final override;
+
+  void render(RenderParams&) final override;
+};
+
+}
+}
+}
+
+#endif /* DIGGLER_RENDER_NULL_PARTICLES_RENDERER_HPP */
@@ -0,0 +1,38 @@
+#include "Renderer.hpp"
+
+#include "../../util/Log.hpp"
+#include "FontRenderer.hpp"
+#include "ParticlesRenderer.hpp"
+#include "TextureManager.hpp"
+#include "WorldRenderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+using Util::Log;
+using namespace Util::Logging::LogLevels;
+
+static const char *TAG = "NullRenderer";
+
+NullRenderer::NullRenderer(Game *G) :
+  Renderer(G) {
+  Log(Verbose, TAG) << "NullRenderer, no graphics output";
+  renderers.font = std::make_unique<NullFontRenderer>();
+  renderers.particles = std::make_unique<NullParticlesRenderer>();
+  renderers.world = std::make_unique<NullWorldRenderer>(G);
+  textureManager = std::make_unique<TextureManager>();
+}
+
+NullRenderer::~NullRenderer() {
+}
+
+void NullRenderer::beginFrame() {
+}
+
+void NullRenderer::endFrame() {
+}
+
+}
+}
+}
@@ -0,0 +1,27 @@
+#ifndef DIGGLER_RENDER_NULL_RENDERER_HPP
+#define DIGGLER_RENDER_NULL_RENDERER_HPP
+
+#include "../Renderer.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+///
+/// @brief Renderer that does all CPU-side work but never touches a graphics API.
+/// Allows running client code without a GPU or display, e.g. for bots and benchmarks.
+///
+class NullRenderer : public Renderer {
+public:
+  NullRenderer(Game *G);
+  ~NullRenderer();
+
+  void beginFrame() override;
+  void endFrame() override;
+};
+
+}
+}
+}
+
+#endif /* DIGGLER_RENDER_NULL_RENDERER_HPP */
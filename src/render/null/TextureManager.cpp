@@ -0,0 +1,107 @@
+#include "TextureManager.hpp"
+
+#include <cstring>
+
+#include "../../util/ColorUtil.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+// Pixels are stored as RGBA, which is also what getTexture() returns
+constexpr static uint StoredTexelSize = 4;
+
+Texture::Texture(uint w, uint h, PixelFormat format, const uint8 *data) :
+  Diggler::Texture(w, h, format),
+  m_data(std::make_unique<uint8[]>(w * h * StoredTexelSize)) {
+  if (data) {
+    store(0, 0, w, h, data, format);
+  }
+}
+
+Texture::~Texture() {
+}
+
+void Texture::store(int x, int y, uint w, uint h, const uint8 *data, PixelFormat format) {
+  const uint texelSize = PixelFormatByteSize(format);
+  for (uint row = 0; row < h; ++row) {
+    uint8 *dst = &m_data[((y + row) * m_w + x) * StoredTexelSize];
+    const uint8 *src = &data[row * w * texelSize];
+    if (format == PixelFormat::RGBA) {
+      std::memcpy(dst, src, w * StoredTexelSize);
+      continue;
+    }
+    for (uint i = 0; i < w; ++i, dst += StoredTexelSize, src += texelSize) {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+      dst[3] = 255;
+    }
+  }
+}
+
+void Texture::getTexture(uint8 *data) {
+  std::memcpy(data, m_data.get(), m_w * m_h * StoredTexelSize);
+}
+
+void Texture::setTexture(std::unique_ptr<const uint8[]> &&data, PixelFormat format) {
+  m_format = format;
+  store(0, 0, m_w, m_h, data.get(), format);
+}
+
+void Texture::setTexture(uint w, uint h, std::unique_ptr<const uint8[]> &&data,
+    PixelFormat format) {
+  if (w != m_w || h != m_h) {
+    m_w = w;
+    m_h = h;
+    m_data = std::make_unique<uint8[]>(w * h * StoredTexelSize);
+  }
+  setTexture(std::move(data), format);
+}
+
+void Texture::setSubTexture(int x, int y, uint w, uint h, std::unique_ptr<const uint8[]> &&data,
+    PixelFormat format) {
+  store(x, y, w, h, data.get(), format);
+}
+
+void Texture::setFiltering(Filter, Filter) {
+}
+
+void Texture::setWrapping(Wrapping, Wrapping) {
+}
+
+void Texture::bind() const {
+}
+
+TextureManager::TextureManager() {
+}
+
+TextureManager::~TextureManager() {
+}
+
+TextureRef TextureManager::createTexture(uint w, uint h, PixelFormat format,
+      byte defaultR, byte defaultG, byte defaultB, byte defaultA) {
+  std::unique_ptr<byte[]> data = std::make_unique<byte[]>(w * h * PixelFormatByteSize(format));
+  switch (format) {
+  case PixelFormat::RGB:
+    Util::ColorUtil::fillRGB888(data.get(), defaultR, defaultG, defaultB, w * h);
+    break;
+  case PixelFormat::RGBA:
+    Util::ColorUtil::fillRGBA8888(data.get(), defaultR, defaultG, defaultB, defaultA, w * h);
+    break;
+  }
+  return std::make_shared<Texture>(w, h, format, data.get());
+}
+
+TextureRef TextureManager::createTexture(uint w, uint h, PixelFormat format,
+      std::unique_ptr<const uint8_t[]> &&data) {
+  return std::make_shared<Texture>(w, h, format, data.get());
+}
+
+uint64 TextureManager::minUsedVideoMem() const {
+  return 0;
+}
+
+}
+}
+}
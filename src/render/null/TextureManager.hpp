@@ -0,0 +1,60 @@
+#ifndef DIGGLER_RENDER_NULL_TEXTURE_MANAGER_HPP
+#define DIGGLER_RENDER_NULL_TEXTURE_MANAGER_HPP
+
+#include <memory>
+
+#include "../TextureManager.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+///
+/// @brief Texture kept in system memory, so that its contents can still be read back.
+///
+class Texture : public Diggler::Texture {
+private:
+  std::unique_ptr<uint8[]> m_data;
+
+  void store(int x, int y, uint w, uint h, const uint8 *data, PixelFormat format);
+
+public:
+  Texture(uint w, uint h, PixelFormat format, const uint8 *data = nullptr);
+  ~Texture();
+
+  void getTexture(uint8 *data) override;
+
+  void setTexture(std::unique_ptr<const uint8[]> &&data, PixelFormat format) override;
+
+  void setTexture(uint w, uint h, std::unique_ptr<const uint8[]> &&data,
+      PixelFormat format) override;
+
+  void setSubTexture(int x, int y, uint w, uint h, std::unique_ptr<const uint8[]> &&data,
+      PixelFormat format) override;
+
+  void setFiltering(Filter min, Filter mag) override;
+
+  void setWrapping(Wrapping s, Wrapping t) override;
+  using Diggler::Texture::setWrapping;
+
+  void bind() const override;
+};
+
+class TextureManager : public Render::TextureManager {
+public:
+  TextureManager();
+  ~TextureManager();
+
+  TextureRef createTexture(uint w, uint h, PixelFormat format,
+      byte defaultR = 128, byte defaultG = 128, byte defaultB = 128, byte defaultA = 255) override;
+  TextureRef createTexture(uint w, uint h, PixelFormat format,
+      std::unique_ptr<const uint8_t[]> &&data) override;
+
+  uint64 minUsedVideoMem() const override;
+};
+
+}
+}
+}
+
+#endif /* DIGGLER_RENDER_NULL_TEXTURE_MANAGER_HPP */
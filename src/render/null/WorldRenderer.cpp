@@ -0,0 +1,108 @@
+#include "WorldRenderer.hpp"
+
+#include <glm/glm.hpp>
+
+#include "../../FrameProfiler.hpp"
+#include "../../Game.hpp"
+
+namespace Diggler {
+namespace Render {
+namespace null {
+
+NullWorldRenderer::NullWorldRenderer(Game *G) :
+  WorldRenderer(pointedHighlight),
+  G(G),
+  stats{0, 0, 0} {
+}
+
+NullWorldRenderer::~NullWorldRenderer() {
+}
+
+void NullWorldRenderer::registerChunk(Chunk *c) {
+  if (c == nullptr) {
+    return;
+  }
+  setRendererData(c, reinterpret_cast<uintptr_t>(new ChunkEntry));
+  m_frustumCuller.add(c);
+}
+
+void NullWorldRenderer::updateChunk(Chunk *c, uint8 lod, const Chunk::MeshView &mesh) {
+  Mesh &m = reinterpret_cast<ChunkEntry*>(getRendererData(c))->lods[lod];
+  const uint64 bytes = mesh.vertCount * sizeof(Chunk::Vertex) +
+    (mesh.idxOpqCount + mesh.idxTptCount) * mesh.indexSize;
+  stats.meshBytes += bytes - m.bytes;
+  m_uploadedBytes += bytes;
+  FrameStats &fs = G->FP->current();
+  ++fs.meshesRebuilt;
+  fs.bytesUploaded += bytes;
+  m.built = true;
+  m.vertCount = mesh.vertCount;
+  m.indicesOpq = mesh.idxOpqCount;
+  m.indicesTpt = mesh.idxTptCount;
+  m.bytes = bytes;
+}
+
+void NullWorldRenderer::unregisterChunk(Chunk *c) {
+  if (c == nullptr) {
+    return;
+  }
+  m_frustumCuller.remove(c);
+  ChunkEntry *ce = reinterpret_cast<ChunkEntry*>(getRendererData(c));
+  for (const Mesh &m : ce->lods) {
+    stats.meshBytes -= m.bytes;
+  }
+  delete ce;
+}
+
+void NullWorldRenderer::render(RenderParams &rp) {
+  const static glm::vec3 cShift(Chunk::MidX, Chunk::MidY, Chunk::MidZ);
+  FrameStats &fs = G->FP->current();
+  bool occlusion;
+  { FrameProfiler::Scope scope(fs, FrameStats::Phase::Culling);
+    occlusion = G->RP->occlusionCulling &&
+      m_occlusionCuller.run(*rp.world, rp.cameraPos, rp.frustum);
+    m_visibleChunks.clear();
+    m_frustumCuller.cull(rp.frustum, m_visibleChunks);
+  }
+
+  m_drawList.clear();
+  for (Chunk *c : m_visibleChunks) {
+    if (c->W.get() != rp.world)
+      continue;
+    if (occlusion && !m_occlusionCuller.isVisible(*c))
+      continue;
+    const glm::vec3 center = glm::vec3(c->wcx * Chunk::CX, c->wcy * Chunk::CY,
+      c->wcz * Chunk::CZ) + cShift;
+    const float distance = glm::distance(center, rp.cameraPos);
+    const uint8 lod = selectLod(distance, G->RP->lodDistance);
+    if (c->isDirty(lod))
+      m_rebuildQueue.push_back({ distance, c, lod });
+    m_drawList.push_back({ distance, c, lod });
+  }
+  { FrameProfiler::Scope scope(fs, FrameStats::Phase::Meshing);
+    rebuildQueued(G->RP->chunkRebuildBudget, G->RP->chunkUploadBudget);
+  }
+
+  stats.chunksDrawn = 0;
+  stats.indicesDrawn = 0;
+  for (const DrawItem &di : m_drawList) {
+    const Mesh &m = reinterpret_cast<ChunkEntry*>(getRendererData(di.chunk))->lods[di.lod];
+    if (m.indicesOpq + m.indicesTpt > 0) {
+      ++stats.chunksDrawn;
+      ++fs.lodChunksDrawn[di.lod];
+      stats.indicesDrawn += m.indicesOpq + m.indicesTpt;
+    }
+  }
+  fs.chunksConsidered += m_frustumCuller.stats.chunksCulled + m_frustumCuller.stats.chunksVisible;
+  fs.chunksCulled += m_frustumCuller.stats.chunksCulled +
+    (m_frustumCuller.stats.chunksVisible - m_drawList.size());
+  fs.chunksDrawn += stats.chunksDrawn;
+  fs.triangles += stats.indicesDrawn / 3;
+}
+
+void NullWorldRenderer::renderTransparent(RenderParams&) {
+}
+
+}
+}
+}
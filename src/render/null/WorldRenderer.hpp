@@ -0,0 +1,73 @@
+#ifndef DIGGLER_RENDER_NULL_WORLD_RENDERER_HPP
+#define DIGGLER_RENDER_NULL_WORLD_RENDERER_HPP
+
+#include "../WorldRenderer.hpp"
+
+#include <vector>
+
+#include "../../ChunkFrustumCuller.hpp"
+#include "../../ChunkVisibility.hpp"
+
+namespace Diggler {
+
+class Game;
+
+namespace Render {
+namespace null {
+
+///
+/// @brief World renderer going through culling, LOD selection and mesh rebuild scheduling
+/// like a real one, only keeping track of mesh sizes instead of uploading and drawing them.
+///
+class NullWorldRenderer : public WorldRenderer {
+protected:
+  Game *G;
+
+  struct Mesh {
+    bool built = false;
+    uint vertCount = 0, indicesOpq = 0, indicesTpt = 0;
+    uint64 bytes = 0;
+  };
+  struct ChunkEntry {
+    Mesh lods[Chunk::LodLevels];
+  };
+  ChunkFrustumCuller m_frustumCuller;
+  ChunkOcclusionCuller m_occlusionCuller;
+  std::vector<Chunk*> m_visibleChunks;
+  std::vector<DrawItem> m_drawList;
+
+public:
+  struct PointedHighlight : public WorldRenderer::PointedHighlight {
+    void setVisible(bool) {}
+    void setColor(uint8, uint8, uint8, uint8) {}
+    void setCenter(const glm::vec3&) {}
+  } pointedHighlight;
+
+  struct Stats {
+    /// Chunks and indices that would have been drawn by the last frame.
+    uint chunksDrawn;
+    uint64 indicesDrawn;
+    /// Total size of all meshes, as they would be stored in graphics memory.
+    uint64 meshBytes;
+  } stats;
+
+  NullWorldRenderer(Game*);
+  ~NullWorldRenderer();
+
+  void registerChunk(Chunk*);
+  void updateChunk(Chunk*, uint8 lod, const Chunk::MeshView&);
+  void unregisterChunk(Chunk*);
+
+  void render(RenderParams&);
+  void renderTransparent(RenderParams&);
+
+  const ChunkFrustumCuller::Stats& frustumCullingStats() const {
+    return m_frustumCuller.stats;
+  }
+};
+
+}
+}
+}
+
+#endif /* DIGGLER_RENDER_NULL_WORLD_RENDERER_HPP */
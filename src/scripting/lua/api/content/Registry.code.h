@@ -1,2 +1,4 @@
 void Diggler_Content_Registry_registerBlock(struct Diggler_Game*,
   const char *name, struct Diggler_Content_BlockDef*);
+void Diggler_Content_Registry_beginTextureBatch(struct Diggler_Game*);
+void Diggler_Content_Registry_endTextureBatch(struct Diggler_Game*);
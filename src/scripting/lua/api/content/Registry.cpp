@@ -23,24 +23,10 @@ void Diggler_Content_Registry_registerBlock(struct Diggler_Game *cG,
         std::forward_as_tuple());
       decltype(app.textures)::iterator &it = itPair.first;
       decltype(app.textures)::value_type::second_type &tex = it->second;
-      tex.coord = G.CR->addTexture(cTex.name, cTex.path);
       cTex.repeatXdiv = cTex.repeatYdiv = 4;
       tex.repeat.xdiv = cTex.repeatXdiv;
       tex.repeat.ydiv = cTex.repeatYdiv;
-      if (cTex.repeatXdiv > 1 || cTex.repeatYdiv > 1) {
-        uint16 width  = (tex.coord.u - tex.coord.x) / cTex.repeatXdiv,
-               height = (tex.coord.v - tex.coord.y) / cTex.repeatYdiv;
-        for (int16 y = cTex.repeatYdiv - 1; y >= 0; --y) {
-          for (int16 x = cTex.repeatXdiv - 1; x >= 0; --x) {
-            tex.divCoords.emplace_back(Util::TexturePacker::Coord {
-              static_cast<uint16>(tex.coord.x + width * x),
-              static_cast<uint16>(tex.coord.y + height * y),
-              static_cast<uint16>(tex.coord.x + width * (x + 1)),
-              static_cast<uint16>(tex.coord.y + height * (y + 1))
-            });
-          }
-        }
-      }
+      br.loadTexture(cTex.name, cTex.path);
       textureIts.emplace_back(it);
     }
     { decltype(cApp.look) &cLook = cApp.look;
@@ -60,3 +46,13 @@ void Diggler_Content_Registry_registerBlock(struct Diggler_Game *cG,
   }
   br.commit();
 }
+
+void Diggler_Content_Registry_beginTextureBatch(struct Diggler_Game *cG) {
+  Game &G = *reinterpret_cast<Game*>(cG);
+  G.CR->beginTextureBatch();
+}
+
+void Diggler_Content_Registry_endTextureBatch(struct Diggler_Game *cG) {
+  Game &G = *reinterpret_cast<Game*>(cG);
+  G.CR->endTextureBatch();
+}
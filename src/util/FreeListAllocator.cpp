@@ -0,0 +1,63 @@
+#include "FreeListAllocator.hpp"
+
+#include <iterator>
+
+namespace Diggler {
+namespace Util {
+
+FreeListAllocator::FreeListAllocator(Offset capacity) :
+  m_capacity(capacity),
+  m_freeSpace(capacity) {
+  if (capacity > 0) {
+    m_free.emplace(0, capacity);
+  }
+}
+
+FreeListAllocator::Offset FreeListAllocator::allocate(Offset size, Offset alignment) {
+  if (size == 0 || size > m_freeSpace) {
+    return InvalidOffset;
+  }
+  for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+    const Offset start = it->first, end = it->first + it->second;
+    const Offset aligned = (start + alignment - 1) / alignment * alignment;
+    if (aligned > end || end - aligned < size) {
+      continue;
+    }
+    m_free.erase(it);
+    // Keep whatever the alignment and the allocation leave on either side
+    if (aligned > start) {
+      m_free.emplace(start, aligned - start);
+    }
+    if (aligned + size < end) {
+      m_free.emplace(aligned + size, end - (aligned + size));
+    }
+    m_freeSpace -= size;
+    return aligned;
+  }
+  return InvalidOffset;
+}
+
+void FreeListAllocator::free(Offset offset, Offset size) {
+  if (size == 0) {
+    return;
+  }
+  m_freeSpace += size;
+  auto next = m_free.lower_bound(offset);
+  // Merge with the following free range
+  if (next != m_free.end() && next->first == offset + size) {
+    size += next->second;
+    next = m_free.erase(next);
+  }
+  // Merge with the preceding free range
+  if (next != m_free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+  m_free.emplace_hint(next, offset, size);
+}
+
+}
+}
@@ -0,0 +1,55 @@
+#ifndef DIGGLER_UTIL_FREE_LIST_ALLOCATOR_HPP
+#define DIGGLER_UTIL_FREE_LIST_ALLOCATOR_HPP
+
+#include <map>
+
+#include "../platform/Types.hpp"
+
+namespace Diggler {
+namespace Util {
+
+/**
+ * @brief Sub-allocates ranges of an abstract [0, capacity) space, e.g. parts of a GPU buffer.
+ * First-fit; freed ranges are merged with their free neighbours to limit fragmentation.
+ * Doesn't touch the space itself, hence works with any unit (bytes, vertices...).
+ */
+class FreeListAllocator {
+public:
+  using Offset = uint32;
+  constexpr static Offset InvalidOffset = ~Offset(0);
+
+  FreeListAllocator(Offset capacity);
+
+  /**
+   * @brief Allocates a range.
+   * @param size Size of the range.
+   * @param alignment Alignment of the range's start.
+   * @return Offset of the range, or InvalidOffset if no free range is large enough.
+   */
+  Offset allocate(Offset size, Offset alignment = 1);
+
+  /**
+   * @brief Frees a range obtained from allocate().
+   * @param offset Offset returned by allocate().
+   * @param size Size given to allocate().
+   */
+  void free(Offset offset, Offset size);
+
+  Offset capacity() const {
+    return m_capacity;
+  }
+
+  Offset freeSpace() const {
+    return m_freeSpace;
+  }
+
+private:
+  Offset m_capacity, m_freeSpace;
+  // Free ranges, offset -> size
+  std::map<Offset, Offset> m_free;
+};
+
+}
+}
+
+#endif /* DIGGLER_UTIL_FREE_LIST_ALLOCATOR_HPP */
@@ -0,0 +1,98 @@
+#include "JobPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Diggler {
+namespace Util {
+
+JobPool::JobPool(uint threadCount) :
+  m_run(true) {
+  if (threadCount == 0) {
+    const uint hw = std::thread::hardware_concurrency();
+    threadCount = hw > 1 ? hw - 1 : 1;
+  }
+  m_threads.reserve(threadCount);
+  for (uint i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&JobPool::workerProc, this);
+  }
+}
+
+JobPool::~JobPool() {
+  { std::unique_lock<std::mutex> lk(m_mutex);
+    m_run = false;
+  }
+  m_cv.notify_all();
+  for (std::thread &t : m_threads) {
+    t.join();
+  }
+}
+
+void JobPool::submit(Job &&job) {
+  { std::unique_lock<std::mutex> lk(m_mutex);
+    m_jobs.emplace(std::move(job));
+  }
+  m_cv.notify_one();
+}
+
+void JobPool::workerProc() {
+  while (true) {
+    Job job;
+    { std::unique_lock<std::mutex> lk(m_mutex);
+      m_cv.wait(lk, [this] { return !m_run || !m_jobs.empty(); });
+      if (m_jobs.empty()) {
+        // Only reached when stopping
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop();
+    }
+    job();
+  }
+}
+
+void JobPool::parallelFor(std::size_t count, std::size_t grain,
+  const std::function<void(std::size_t, std::size_t)> &func) {
+  if (grain == 0) {
+    grain = 1;
+  }
+  const std::size_t rangeCount = (count + grain - 1) / grain;
+  if (rangeCount <= 1) {
+    if (count > 0) {
+      func(0, count);
+    }
+    return;
+  }
+  // Shared with the helper jobs, which may only get to run after all ranges are done and this
+  // function returned; they then find no range left and never touch `func`.
+  struct State {
+    std::atomic<std::size_t> next, remaining;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  const std::shared_ptr<State> state = std::make_shared<State>();
+  state->next = 0;
+  state->remaining = rangeCount;
+  const auto work = [state, rangeCount, grain, count, &func]() {
+    std::size_t r;
+    while ((r = state->next.fetch_add(1)) < rangeCount) {
+      const std::size_t begin = r * grain;
+      func(begin, std::min(begin + grain, count));
+      if (state->remaining.fetch_sub(1) == 1) {
+        std::unique_lock<std::mutex> lk(state->mutex);
+        state->cv.notify_all();
+      }
+    }
+  };
+  const std::size_t helpers = std::min<std::size_t>(m_threads.size(), rangeCount - 1);
+  for (std::size_t i = 0; i < helpers; ++i) {
+    submit(work);
+  }
+  work();
+  std::unique_lock<std::mutex> lk(state->mutex);
+  state->cv.wait(lk, [&state] { return state->remaining.load() == 0; });
+}
+
+}
+}
@@ -0,0 +1,60 @@
+#ifndef DIGGLER_UTIL_JOB_POOL_HPP
+#define DIGGLER_UTIL_JOB_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "../platform/PreprocUtils.hpp"
+#include "../platform/Types.hpp"
+
+namespace Diggler {
+namespace Util {
+
+/**
+ * @brief Fixed set of worker threads running queued jobs.
+ * Meant for short CPU-bound work split across cores; jobs must not block on one another.
+ */
+class JobPool {
+public:
+  using Job = std::function<void()>;
+
+  /**
+   * @param threadCount Number of workers, 0 picking one less than the hardware threads since
+   * the thread calling parallelFor() also takes part.
+   */
+  JobPool(uint threadCount = 0);
+  ~JobPool();
+  nocopymove(JobPool);
+
+  uint threadCount() const {
+    return static_cast<uint>(m_threads.size());
+  }
+
+  void submit(Job&&);
+
+  /**
+   * @brief Splits [0, count) in ranges of at most `grain` items and runs `func(begin, end)` on
+   * each, on the workers and the calling thread. Returns once all ranges are done.
+   */
+  void parallelFor(std::size_t count, std::size_t grain,
+    const std::function<void(std::size_t begin, std::size_t end)> &func);
+
+private:
+  std::vector<std::thread> m_threads;
+  std::queue<Job> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_run;
+
+  void workerProc();
+};
+
+}
+}
+
+#endif /* DIGGLER_UTIL_JOB_POOL_HPP */
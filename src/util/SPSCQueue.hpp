@@ -0,0 +1,102 @@
+#ifndef DIGGLER_UTIL_SPSC_QUEUE_HPP
+#define DIGGLER_UTIL_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "../platform/PreprocUtils.hpp"
+
+namespace Diggler {
+namespace Util {
+
+/**
+ * @brief Bounded lock-free queue between exactly one producer thread and one consumer thread.
+ * Items live in a ring buffer whose head is only written by the consumer and tail only by the
+ * producer, each kept on its own cache line along with its thread's copy of the other index.
+ */
+template<typename T>
+class SPSCQueue {
+public:
+  /**
+   * @param capacity Minimum number of items the queue holds, rounded up to a power of two.
+   */
+  explicit SPSCQueue(std::size_t capacity) :
+    m_mask(roundUp(capacity) - 1),
+    m_slots(new T[m_mask + 1]),
+    m_head(0),
+    m_cachedTail(0),
+    m_tail(0),
+    m_cachedHead(0) {
+  }
+  nocopymove(SPSCQueue);
+
+  std::size_t capacity() const {
+    return m_mask + 1;
+  }
+
+  /**
+   * @brief Producer side. Moves `item` into the queue.
+   * @returns false, leaving `item` untouched, if the queue is full.
+   */
+  bool push(T &item) {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_cachedHead > m_mask) {
+      m_cachedHead = m_head.load(std::memory_order_acquire);
+      if (tail - m_cachedHead > m_mask) {
+        return false;
+      }
+    }
+    m_slots[tail & m_mask] = std::move(item);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Consumer side. Moves the oldest item into `item`.
+   * @returns false if the queue is empty.
+   */
+  bool pop(T &item) {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_cachedTail) {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head == m_cachedTail) {
+        return false;
+      }
+    }
+    item = std::move(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  constexpr static std::size_t CacheLineSize = 64;
+
+  static std::size_t roundUp(std::size_t n) {
+    std::size_t p = 1;
+    while (p < n) {
+      p <<= 1;
+    }
+    return p;
+  }
+
+  const std::size_t m_mask;
+  const std::unique_ptr<T[]> m_slots;
+
+  // Consumer-owned
+  char m_pad0[CacheLineSize];
+  std::atomic<std::size_t> m_head;
+  std::size_t m_cachedTail;
+
+  // Producer-owned
+  char m_pad1[CacheLineSize - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+  std::atomic<std::size_t> m_tail;
+  std::size_t m_cachedHead;
+  char m_pad2[CacheLineSize - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+};
+
+}
+}
+
+#endif /* DIGGLER_UTIL_SPSC_QUEUE_HPP */
@@ -1,7 +1,9 @@
 #include "TexturePacker.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <thread>
 
@@ -11,6 +13,7 @@
 #include "../render/Renderer.hpp"
 #include "../Texture.hpp"
 #include "BitmapDumper.hpp"
+#include "JobPool.hpp"
 #include "Log.hpp"
 
 using namespace std;
@@ -27,6 +30,8 @@ using namespace Logging::LogLevels;
 
 static const char *TAG = "TexturePacker";
 
+constexpr int TexturePacker::MaxAtlasSize;
+
 // https://gist.github.com/fairlight1337/4935ae72bcbcc1ba5c72
 static void HSVtoRGB(float h, float s, float v, float &r, float &g, float &b) {
   const float c = v * s; // Chroma
@@ -70,115 +75,277 @@ static void HSVtoRGB(float h, float s, float v, float &r, float &g, float &b) {
 }
 
 TexturePacker::TexturePacker(Game &G, uint w, uint h) :
-  atlasWidth(w), atlasHeight(h), m_freezeTexUpdate(false) {
-  if (w <= 2 || h <= 2)
+  atlasWidth(w), atlasHeight(h), m_freezeTexUpdate(false),
+  // Upload the initial, empty contents
+  m_resized(true) {
+  if (w <= 2 || h <= 2 || w > static_cast<uint>(MaxAtlasSize) ||
+      h > static_cast<uint>(MaxAtlasSize))
     throw std::invalid_argument("Bad dimensions");
 
   atlasData = std::make_unique<uint8[]>(w * h * 4);
   memset(atlasData.get(), 0, w * h * 4);
   atlasTex = G.R->textureManager->createTexture(w, h, PixelFormat::RGBA);
+  m_skyline.push_back(SkylineNode { 0, 0, atlasWidth });
   updateTex();
 }
 
 TexturePacker::~TexturePacker() {
 }
 
+TexturePacker::Coord TexturePacker::addDefault() {
+  if (!m_defaultTexture) {
+    m_defaultTexture.reset(new uint8[8*8*4]);
+    uint i = 0;
+    for (uint8 y = 0; y < 8; ++y) {
+      for (uint8 x = 0; x < 8; ++x) {
+        m_defaultTexture[i] = m_defaultTexture[i + 1] = m_defaultTexture[i + 2] = (x ^ y) * 32;
+        m_defaultTexture[i + 3] = 255;
+        i += 4;
+      }
+    }
+    int x = 0, y = 0, xi = 1, yi = 0; uint c = 0;
+    while (true) {
+      float r, g, b;
+      i = (y * 8 + x) * 4;
+      HSVtoRGB(c * (360.f / (8+8+6+6)), 1.f, 1.f, r, g, b);
+      m_defaultTexture[i    ] = static_cast<uint8>(r * 255);
+      m_defaultTexture[i + 1] = static_cast<uint8>(g * 255);
+      m_defaultTexture[i + 2] = static_cast<uint8>(b * 255);
+      m_defaultTexture[i + 3] = 255;
+      if (x == 7) {
+        if (y == 0) {
+          xi = 0; yi = 1;
+        } else if (y == 7) {
+          xi = -1; yi = 0;
+        }
+      } else if (x == 0) {
+        if (y == 7) {
+          xi = 0; yi = -1;
+        } else if (y == 1) {
+          break;
+        }
+      }
+      x += xi; y += yi; ++c;
+    }
+  }
+  return add(8, 8, 4, m_defaultTexture.get());
+}
+
 TexturePacker::Coord TexturePacker::add(const std::string& path) {
   // Load image
   int width, height, channels;
   unsigned char *ptr = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
   if (!ptr || !width || !height) {
     Log(Error, TAG) << "Could not load '" << path << "': " << stbi_failure_reason();
-    if (!m_defaultTexture) {
-      m_defaultTexture.reset(new uint8[8*8*4]);
-      uint i = 0;
-      for (uint8 y = 0; y < 8; ++y) {
-        for (uint8 x = 0; x < 8; ++x) {
-          m_defaultTexture[i] = m_defaultTexture[i + 1] = m_defaultTexture[i + 2] = (x ^ y) * 32;
-          m_defaultTexture[i + 3] = 255;
-          i += 4;
-        }
-      }
-      int x = 0, y = 0, xi = 1, yi = 0; uint c = 0;
-      while (true) {
-        float r, g, b;
-        i = (y * 8 + x) * 4;
-        HSVtoRGB(c * (360.f / (8+8+6+6)), 1.f, 1.f, r, g, b);
-        m_defaultTexture[i    ] = static_cast<uint8>(r * 255);
-        m_defaultTexture[i + 1] = static_cast<uint8>(g * 255);
-        m_defaultTexture[i + 2] = static_cast<uint8>(b * 255);
-        m_defaultTexture[i + 3] = 255;
-        if (x == 7) {
-          if (y == 0) {
-            xi = 0; yi = 1;
-          } else if (y == 7) {
-            xi = -1; yi = 0;
-          }
-        } else if (x == 0) {
-          if (y == 7) {
-            xi = 0; yi = -1;
-          } else if (y == 1) {
-            break;
-          }
-        }
-        x += xi; y += yi; ++c;
-      }
-    }
-    return add(8, 8, 4, m_defaultTexture.get());
+    return addDefault();
   }
+  return addDecoded(path, ptr, width, height);
+}
+
+TexturePacker::Coord TexturePacker::addDecoded(const std::string &path, uint8 *rgba, int width,
+  int height) {
   if (width % 4 != 0 || height % 4 != 0) {
     Log(Error, TAG) << path << " is bad: " << width << 'x' << height;
-    stbi_image_free(ptr);
+    stbi_image_free(rgba);
     return Coord { 0, 0, 0, 0 };
   }
 
-  Coord result = add(width, height, channels, ptr);
+  // stbi_load was asked for RGBA, whatever the file's channel count
+  Coord result = add(width, height, 4, rgba);
 
   // Free the image buffer
-  stbi_image_free(ptr);
+  stbi_image_free(rgba);
+  return result;
+}
+
+std::vector<TexturePacker::Coord> TexturePacker::add(const std::vector<std::string> &paths,
+  JobPool &JP) {
+  struct Decoded {
+    uint8 *data;
+    int width, height;
+    const char *error;
+  };
+  std::vector<Decoded> images(paths.size(), Decoded { nullptr, 0, 0, nullptr });
+  JP.parallelFor(paths.size(), 1, [&paths, &images](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      int channels;
+      Decoded &img = images[i];
+      img.data = stbi_load(paths[i].c_str(), &img.width, &img.height, &channels, STBI_rgb_alpha);
+      // The failure reason is thread-local
+      img.error = stbi_failure_reason();
+    }
+  });
+
+  // Tallest first packs tighter on the skyline
+  std::vector<std::size_t> order(paths.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&images](std::size_t a, std::size_t b) {
+    return images[a].height > images[b].height;
+  });
+
+  const bool wasFrozen = m_freezeTexUpdate;
+  m_freezeTexUpdate = true;
+  std::vector<Coord> result(paths.size());
+  // Atlas size each coordinate was normalized against, as it may grow during the batch
+  std::vector<std::pair<int, int>> sizes(paths.size());
+  std::size_t done = 0;
+  try {
+    for (; done < order.size(); ++done) {
+      const std::size_t i = order[done];
+      Decoded &img = images[i];
+      uint8 *const data = img.data;
+      img.data = nullptr;
+      if (!data || !img.width || !img.height) {
+        Log(Error, TAG) << "Could not load '" << paths[i] << "': " << img.error;
+        stbi_image_free(data);
+        result[i] = addDefault();
+      } else {
+        result[i] = addDecoded(paths[i], data, img.width, img.height);
+      }
+      sizes[i] = std::make_pair(atlasWidth, atlasHeight);
+    }
+  } catch (...) {
+    for (; done < order.size(); ++done) {
+      stbi_image_free(images[order[done]].data);
+    }
+    m_freezeTexUpdate = wasFrozen;
+    throw;
+  }
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    result[i] = rescale(result[i], sizes[i].first, sizes[i].second);
+  }
+  freezeTexUpdate(wasFrozen);
   return result;
 }
 
 using Coord = TexturePacker::Coord;
-static bool coordCollides(const Coord &c, const std::vector<Coord> &cs) {
-  for (const Coord &tc : cs) {
-    bool xOverlap = (c.x >= tc.x && c.x < tc.u) || (c.u > tc.x && c.u <= tc.u);
-    bool yOverlap = (c.y >= tc.y && c.y < tc.v) || (c.v > tc.y && c.v <= tc.v);
-    /*getDebugStream() << "Collide? {" << c.x << ", " << c.y << ", " << c.u << ", " << c.v
-      << "} {" << tc.x << ", " << tc.y << ", " << tc.u << ", " << tc.v << "} = "
-      << xOverlap << '&' << yOverlap << std::endl;*/
-    if (xOverlap && yOverlap)
-      return true;
-  }
-  return false;
-}
-
-static Coord findCoordinates(const std::vector<Coord> &cs, int w, int h, int mx, int my) {
-  // Almost-naïve find algorithm
-  // Actually not *that* dumb
-  Coord c {0, 0, w, h};
-  if (!coordCollides(c, cs))
-    return c;
-  for (const Coord &tc : cs) {
-    // Right
-    c.x = tc.u; c.y = tc.y;
-    c.u = c.x + w; c.v = c.y + h;
-    if (c.u < mx && c.v < my && !coordCollides(c, cs))
-      return c;
-    // Bottom
-    c.x = tc.x; c.y = tc.v;
-    c.u = c.x + w; c.v = c.y + h;
-    if (c.u < mx && c.v < my && !coordCollides(c, cs))
-      return c;
-  }
-  throw std::runtime_error("No more space found on atlas");
+static uint16 normalize(uint32 px, uint32 size) {
+  return static_cast<uint16>(std::min<uint32>((px << 16) / size, 0xFFFF));
+}
+
+bool TexturePacker::skylineFits(size_t index, int width, int height, int &y) const {
+  const int x = m_skyline[index].x;
+  if (x + width > atlasWidth)
+    return false;
+  int widthLeft = width;
+  y = m_skyline[index].y;
+  while (widthLeft > 0) {
+    y = std::max(y, m_skyline[index].y);
+    if (y + height > atlasHeight)
+      return false;
+    widthLeft -= m_skyline[index].width;
+    ++index;
+  }
+  return true;
+}
+
+bool TexturePacker::skylineFind(int width, int height, int &x, int &y, size_t &index) const {
+  // Bottom-left: lowest resulting top edge, then narrowest skyline segment
+  int bestBottom = std::numeric_limits<int>::max(), bestWidth = 0;
+  bool found = false;
+  for (size_t i = 0; i < m_skyline.size(); ++i) {
+    int fitY;
+    if (!skylineFits(i, width, height, fitY))
+      continue;
+    const int bottom = fitY + height;
+    if (bottom < bestBottom || (bottom == bestBottom && m_skyline[i].width < bestWidth)) {
+      bestBottom = bottom;
+      bestWidth = m_skyline[i].width;
+      x = m_skyline[i].x;
+      y = fitY;
+      index = i;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void TexturePacker::skylineInsert(size_t index, int x, int y, int width, int height) {
+  m_skyline.insert(m_skyline.begin() + index, SkylineNode { x, y + height, width });
+  // Trim or remove the segments now covered by the new one
+  for (size_t i = index + 1; i < m_skyline.size();) {
+    const SkylineNode &prev = m_skyline[i - 1];
+    SkylineNode &node = m_skyline[i];
+    const int overlap = prev.x + prev.width - node.x;
+    if (overlap <= 0)
+      break;
+    node.x += overlap;
+    node.width -= overlap;
+    if (node.width > 0)
+      break;
+    m_skyline.erase(m_skyline.begin() + i);
+  }
+  // Merge neighbouring segments of equal height
+  for (size_t i = 0; i + 1 < m_skyline.size();) {
+    if (m_skyline[i].y == m_skyline[i + 1].y) {
+      m_skyline[i].width += m_skyline[i + 1].width;
+      m_skyline.erase(m_skyline.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void TexturePacker::grow() {
+  const int oldWidth = atlasWidth, oldHeight = atlasHeight;
+  if (atlasWidth < MaxAtlasSize && (atlasWidth <= atlasHeight || atlasHeight >= MaxAtlasSize)) {
+    atlasWidth = std::min(atlasWidth * 2, MaxAtlasSize);
+    if (m_skyline.back().y == 0) {
+      m_skyline.back().width += atlasWidth - oldWidth;
+    } else {
+      m_skyline.push_back(SkylineNode { oldWidth, 0, atlasWidth - oldWidth });
+    }
+  } else {
+    atlasHeight = std::min(atlasHeight * 2, MaxAtlasSize);
+  }
+
+  auto newData = std::make_unique<uint8[]>(atlasWidth * atlasHeight * 4);
+  for (int y = 0; y < oldHeight; ++y) {
+    memcpy(&newData[y * atlasWidth * 4], &atlasData[y * oldWidth * 4], oldWidth * 4);
+  }
+  atlasData = std::move(newData);
+  m_resized = true;
+  Log(Info, TAG) << "Atlas grown to " << atlasWidth << 'x' << atlasHeight;
+
+  if (m_resizeCallback)
+    m_resizeCallback(oldWidth, oldHeight);
+}
+
+Coord TexturePacker::rescale(const Coord &c, int oldWidth, int oldHeight) const {
+  // 0xFFFF is a clamped 0x10000, i.e. the old atlas' right or bottom edge
+  const auto conv = [](uint16 v, int oldSize, int newSize) -> uint16 {
+    const uint32 full = v == 0xFFFF ? 0x10000 : v;
+    return static_cast<uint16>(std::min<uint32>(full * oldSize / newSize, 0xFFFF));
+  };
+  return Coord {
+    conv(c.x, oldWidth, atlasWidth),
+    conv(c.y, oldHeight, atlasHeight),
+    conv(c.u, oldWidth, atlasWidth),
+    conv(c.v, oldHeight, atlasHeight)
+  };
 }
 
 TexturePacker::Coord TexturePacker::add(int width, int height, int channels, const uint8 *data) {
-  // Find a good coord
-  Coord c = findCoordinates(coords, width, height, atlasWidth, atlasHeight);
+  if (width <= 0 || height <= 0 || width > MaxAtlasSize || height > MaxAtlasSize)
+    throw std::invalid_argument("Bad texture dimensions");
+
+  // Find a good coord, growing the atlas until one is found
+  int targetX = 0, targetY = 0;
+  size_t index = 0;
+  while (!skylineFind(width, height, targetX, targetY, index)) {
+    if (atlasWidth >= MaxAtlasSize && atlasHeight >= MaxAtlasSize)
+      throw std::runtime_error("No more space found on atlas");
+    grow();
+  }
+  skylineInsert(index, targetX, targetY, width, height);
+  const Coord c {
+    static_cast<uint16>(targetX), static_cast<uint16>(targetY),
+    static_cast<uint16>(targetX + width), static_cast<uint16>(targetY + height)
+  };
   coords.push_back(c);
-  uint16 targetX = c.x, targetY = c.y;
+  m_dirtyRects.push_back(c);
 
 #if ENABLE_TIMING
   auto t1 = std::chrono::high_resolution_clock::now();
@@ -207,25 +374,44 @@ TexturePacker::Coord TexturePacker::add(int width, int height, int channels, con
   getDebugStream() << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << std::endl;
 #endif
 
-  uint glScaleX = (1 << (sizeof(Coord::x)*8))/atlasWidth,
-       glScaleY = (1 << (sizeof(Coord::y)*8))/atlasHeight;
-
   updateTex();
 
   return Coord {
-    targetX*glScaleX,
-    targetY*glScaleY,
-    (targetX + width)*glScaleX,
-    (targetY + height)*glScaleY,
+    normalize(c.x, atlasWidth),
+    normalize(c.y, atlasHeight),
+    normalize(c.u, atlasWidth),
+    normalize(c.v, atlasHeight)
   };
 }
 
 void TexturePacker::updateTex() {
   if (m_freezeTexUpdate)
     return;
-  auto atlasCopy = std::make_unique<uint8[]>(atlasWidth * atlasHeight * 4);
-  std::memcpy(atlasCopy.get(), atlasData.get(), atlasWidth * atlasHeight * 4);
-  atlasTex->setTexture(std::move(atlasCopy), PixelFormat::RGBA);
+  uint64 dirtyArea = 0;
+  for (const Coord &r : m_dirtyRects) {
+    dirtyArea += (r.u - r.x) * (r.v - r.y);
+  }
+  // Past half of the atlas, a single full upload beats many small ones
+  if (m_resized || dirtyArea * 2 >= static_cast<uint64>(atlasWidth * atlasHeight)) {
+    auto atlasCopy = std::make_unique<uint8[]>(atlasWidth * atlasHeight * 4);
+    std::memcpy(atlasCopy.get(), atlasData.get(), atlasWidth * atlasHeight * 4);
+    if (m_resized) {
+      atlasTex->setTexture(atlasWidth, atlasHeight, std::move(atlasCopy), PixelFormat::RGBA);
+    } else {
+      atlasTex->setTexture(std::move(atlasCopy), PixelFormat::RGBA);
+    }
+    m_resized = false;
+  } else {
+    for (const Coord &r : m_dirtyRects) {
+      const uint w = r.u - r.x, h = r.v - r.y;
+      auto rectData = std::make_unique<uint8[]>(w * h * 4);
+      for (uint y = 0; y < h; ++y) {
+        std::memcpy(&rectData[y * w * 4], &atlasData[((r.y + y) * atlasWidth + r.x) * 4], w * 4);
+      }
+      atlasTex->setSubTexture(r.x, r.y, w, h, std::move(rectData), PixelFormat::RGBA);
+    }
+  }
+  m_dirtyRects.clear();
   // BitmapDumper::dumpAsPpm(atlasWidth, atlasHeight, atlasData, "/tmp/diggler_atlas.ppm");
 }
 
@@ -1,6 +1,7 @@
 #ifndef DIGGLER_UTIL_TEXTURE_PACKER_HPP
 #define DIGGLER_UTIL_TEXTURE_PACKER_HPP
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -13,14 +14,31 @@ class Game;
 
 namespace Util {
 
+class JobPool;
+
+///
+/// @brief Packs textures onto a single atlas using the skyline bottom-left heuristic.
+/// The atlas doubles in size, up to MaxAtlasSize, when a texture doesn't fit. Only the regions
+/// that changed since the last upload are sent to the GPU.
+///
 class TexturePacker {
 public:
+  /// Texture coordinates, normalized so that 65536 (clamped to 65535) spans the whole atlas.
   struct Coord {
     uint16 x, y, u, v;
   };
+  /// Placed textures, in atlas pixels.
   std::vector<Coord> coords;
   int atlasWidth, atlasHeight;
 
+  constexpr static int MaxAtlasSize = 8192;
+
+  ///
+  /// @brief Called after the atlas grew, with its previous size.
+  /// Normalized coordinates handed out before the call must be converted with rescale().
+  ///
+  using ResizeCallback = std::function<void(int oldWidth, int oldHeight)>;
+
 private:
   std::unique_ptr<uint8[]> m_defaultTexture;
 
@@ -28,8 +46,29 @@ private:
 
   std::shared_ptr<Texture> atlasTex;
   bool m_freezeTexUpdate;
+
+  struct SkylineNode {
+    int x, y, width;
+  };
+  /// Top edge of the packed area, sorted by x and covering the whole atlas width.
+  std::vector<SkylineNode> m_skyline;
+
+  /// Regions written to since the last upload, in atlas pixels.
+  std::vector<Coord> m_dirtyRects;
+  /// Whether the atlas was resized since the last upload, requiring a full one.
+  bool m_resized;
+
+  ResizeCallback m_resizeCallback;
+
+  bool skylineFits(size_t index, int width, int height, int &y) const;
+  bool skylineFind(int width, int height, int &x, int &y, size_t &index) const;
+  void skylineInsert(size_t index, int x, int y, int width, int height);
+  void grow();
   void updateTex();
 
+  Coord addDefault();
+  Coord addDecoded(const std::string &path, uint8 *rgba, int width, int height);
+
   // No copy
   TexturePacker(const TexturePacker&) = delete;
   TexturePacker& operator=(const TexturePacker&) = delete;
@@ -41,7 +80,26 @@ public:
   Coord add(const std::string &path);
   Coord add(int width, int height, int channels, const uint8* data);
 
+  ///
+  /// @brief Decodes images in parallel on the JobPool, then packs them and uploads the atlas once.
+  /// @returns Coordinates of each image, in the same order as `paths`.
+  ///
+  std::vector<Coord> add(const std::vector<std::string> &paths, JobPool&);
+
+  ///
+  /// @brief Defers atlas uploads until unfrozen, to batch many add() calls.
+  ///
   void freezeTexUpdate(bool);
+
+  void setResizeCallback(const ResizeCallback &cb) {
+    m_resizeCallback = cb;
+  }
+
+  ///
+  /// @brief Converts a normalized coordinate from an atlas of the old size to the current one.
+  ///
+  Coord rescale(const Coord&, int oldWidth, int oldHeight) const;
+
   const std::shared_ptr<Texture> getAtlas() {
     return atlasTex;
   }
@@ -1,161 +1,162 @@
 #include "Tipsify.hpp"
 
-#include <deque>
-#include <map>
+#include <algorithm>
 #include <vector>
-#include <iostream>
 
 /*
  * Implementation of AMD's Tipsy algorithm
- * Ported from Go, original at https://github.com/tfmoraes/Tipsify-Go
+ * Originally ported from Go, original at https://github.com/tfmoraes/Tipsify-Go
  * The following code is licensed under the MIT License.
  * (So feel free to use it)
+ *
+ * See "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander et al., 2007.
+ * Adjacency is stored as flat CSR arrays and the dead-end stack is never copied, which keeps
+ * the whole thing linear in the vertex and triangle counts.
  */
 
-/*func BuildAdjacency(V [][3]float64, I [][3]int) (A [][]int, L []int);
-
-func Skip_dead_end(L []int, D *[]int, I [][3]int, i int) (int);
-
-func Get_next_vertex(I [][3]int, i int, k int, N map[int]bool, C []int, s int, L []int, D *[]int) (int);
-*/
-std::pair<std::vector<std::vector<int>>, std::vector<int>>
-  BuildAdjacency(std::size_t vertexCount, const std::vector<int[3]> &I) {
-  std::vector<std::vector<int>> A(vertexCount);
-  std::vector<int> L(vertexCount, 0);
-
-  for (std::size_t i = 0; i < I.size(); ++i) {
-    A[I[i][0]].push_back(i);
-    A[I[i][1]].push_back(i);
-    A[I[i][2]].push_back(i);
-
-    ++L[I[i][0]];
-    ++L[I[i][1]];
-    ++L[I[i][2]];
-  }
-
-  return std::make_pair(A, L);
-}
+namespace Diggler {
+namespace Util {
 
-int Skip_dead_end(const std::vector<int> &L, std::vector<int> &D, int i) {
-  std::vector<int> D_(D);
-  for (; D_.size() > 0;) {
-    int d = D_.back();
-    D_.pop_back();
-    if (L[d] > 0) {
-      D = D_;
-      return d;
+namespace {
+
+struct Adjacency {
+  // Triangles using vertex v are tris[offsets[v]] to tris[offsets[v+1]-1]
+  std::vector<uint32> offsets, tris;
+  // Number of not yet emitted triangles using each vertex
+  std::vector<uint32> live;
+
+  template<typename IndexT>
+  Adjacency(const IndexT *I, std::size_t triCount, std::size_t vertexCount) :
+    offsets(vertexCount + 1, 0),
+    tris(triCount * 3),
+    live(vertexCount, 0) {
+    for (std::size_t i = 0; i < triCount * 3; ++i) {
+      ++live[I[i]];
     }
-  }
-  D = D_;
-
-  for (; i < L.size();) {
-    if (L[i] > 0) {
-      return i;
+    for (std::size_t v = 0; v < vertexCount; ++v) {
+      offsets[v + 1] = offsets[v] + live[v];
     }
-    ++i;
-  }
-  return -1;
-}
-
-int Get_next_vertex(const int i, int k, const std::map<int, bool> &N, const std::vector<int> &C, int s,
-  const std::vector<int> &L, std::vector<int> &D) {
-  int n = -1, p = -1, m = 0;
-  for (auto iter = N.begin(); iter != N.end(); ++iter) {
-    int v = iter->first;
-    if (L[v] > 0) {
-      p = 0;
-      if (s - C[v] + 2 * L[v] <= k) {
-        p = s-C[v];
-      }
-      if (p > m) {
-        m = p;
-        n = v;
-      }
+    std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < triCount * 3; ++i) {
+      tris[fill[I[i]]++] = static_cast<uint32>(i / 3);
     }
   }
-  if (n == -1) {
-    n = Skip_dead_end(L, D, i);
-  }
-  return n;
-}
+};
 
-namespace Diggler {
-namespace Util {
+}
 
-std::vector<int[3]> Tipsify::tipsify(std::size_t vertexCount, const std::vector<int[3]> &I, int k) {
-  std::vector<std::vector<int>> A;
-  std::vector<int> L;
-  {
-    std::pair<std::vector<std::vector<int>>, std::vector<int>> AL(BuildAdjacency(vertexCount, I));
-    A = std::move(AL.first);
-    L = std::move(AL.second);
+template<typename IndexT>
+void Tipsify::tipsify(IndexT *I, std::size_t indexCount, std::size_t vertexCount, uint k) {
+  const std::size_t triCount = indexCount / 3;
+  if (triCount == 0 || vertexCount == 0) {
+    return;
   }
-  std::vector<int> C(vertexCount), D;
-  std::vector<bool> E(I.size());
-  const int i = 1;
-  int f = 0, s = k + 1, nf = 0;
-  std::vector<int[3]> O(I.size());
-  for (; f >= 0;) {
-    std::map<int, bool> N;
-    for (int t : A[f]) {
-      if (!E[t]) {
-        for (unsigned int nv = 0; nv < sizeof(I[t])/sizeof(*I[t]); ++nv) {
-          int v = I[t][nv];
-          O[nf][nv] = v;
-          D.push_back(v);
-          N[v] = true;
-          L[v] = L[v] - 1;
-          if (s - C[v] > k) {
-            C[v] = s;
-            ++s;
-          }
+  Adjacency A(I, triCount, vertexCount);
+  std::vector<uint32> &L = A.live;
+  // Cache time stamps
+  std::vector<uint32> C(vertexCount, 0);
+  // Dead-end vertex stack
+  std::vector<uint32> D;
+  D.reserve(indexCount);
+  // Emitted triangles
+  std::vector<bool> E(triCount, false);
+  // 1-ring candidates of the current fanning vertex
+  std::vector<uint32> N;
+  N.reserve(64);
+  std::vector<IndexT> O;
+  O.reserve(triCount * 3);
+
+  // Cursor for the sequential dead-end scan; only ever moves forward
+  std::size_t i = 0;
+  int64 f = 0;
+  uint32 s = k + 1;
+  while (f >= 0) {
+    N.clear();
+    for (uint32 ti = A.offsets[f]; ti < A.offsets[f + 1]; ++ti) {
+      const uint32 t = A.tris[ti];
+      if (E[t]) {
+        continue;
+      }
+      for (int nv = 0; nv < 3; ++nv) {
+        const IndexT v = I[t * 3 + nv];
+        O.push_back(v);
+        D.push_back(v);
+        N.push_back(v);
+        --L[v];
+        if (s - C[v] > k) {
+          C[v] = s;
+          ++s;
         }
-        E[t] = true;
-        ++nf;
       }
+      E[t] = true;
     }
-    f = Get_next_vertex(i, k, N, C, s, L, D);
-  }
-  return O;
-}
-
-// FIFO cache
-struct Cache {
-  using DataT = std::deque<int>;
-  using SizeT = DataT::size_type;
-  SizeT size;
-  DataT data;
 
-  Cache(SizeT size) : size(size) {}
-  bool push(int val) {
-    for (int i : data) {
-      if (i == val) {
-        return false;
+    // Next fanning vertex: the candidate that stays in the cache the longest
+    int64 n = -1;
+    uint32 m = 0;
+    for (uint32 v : N) {
+      if (L[v] > 0) {
+        uint32 p = 0;
+        if (s - C[v] + 2 * L[v] <= k) {
+          p = s - C[v];
+        }
+        if (p > m) {
+          m = p;
+          n = v;
+        }
       }
     }
-    if (data.size() == size) {
-      data.pop_front();
+    if (n == -1) {
+      // Dead end: backtrack through recently used vertices, then scan sequentially
+      while (!D.empty()) {
+        const uint32 d = D.back();
+        D.pop_back();
+        if (L[d] > 0) {
+          n = d;
+          break;
+        }
+      }
+      if (n == -1) {
+        while (i < vertexCount && L[i] == 0) {
+          ++i;
+        }
+        if (i < vertexCount) {
+          n = i;
+        }
+      }
     }
-    data.push_back(val);
-    return true;
+    f = n;
   }
-};
+  std::copy(O.begin(), O.end(), I);
+}
 
-double Tipsify::calcACMR(const std::vector<int[3]> &faces, int cacheSize) {
-  if (faces.empty()) {
+template<typename IndexT>
+double Tipsify::calcACMR(const IndexT *I, std::size_t indexCount, uint cacheSize) {
+  const std::size_t triCount = indexCount / 3;
+  if (triCount == 0 || cacheSize == 0) {
     return 0;
   }
-  Cache cache(cacheSize);
-  int misses = 0;
-  for (const int *face : faces) {
-    for (int i = 0; i < 3; ++i) {
-      if (cache.push(face[i])) {
-        ++misses;
-      }
+  const std::size_t vertexCount = *std::max_element(I, I + triCount * 3) + 1;
+  // A vertex is in the FIFO cache iff fewer than cacheSize misses happened since it was last
+  // inserted
+  std::vector<uint64> insertedAt(vertexCount, 0);
+  std::vector<bool> seen(vertexCount, false);
+  uint64 misses = 0;
+  for (std::size_t i = 0; i < triCount * 3; ++i) {
+    const IndexT v = I[i];
+    if (!seen[v] || misses - insertedAt[v] >= cacheSize) {
+      seen[v] = true;
+      insertedAt[v] = misses;
+      ++misses;
     }
   }
-  return static_cast<double>(misses) / faces.size();
+  return static_cast<double>(misses) / triCount;
 }
 
+template void Tipsify::tipsify<uint16>(uint16*, std::size_t, std::size_t, uint);
+template void Tipsify::tipsify<uint32>(uint32*, std::size_t, std::size_t, uint);
+template double Tipsify::calcACMR<uint16>(const uint16*, std::size_t, uint);
+template double Tipsify::calcACMR<uint32>(const uint32*, std::size_t, uint);
+
 }
 }
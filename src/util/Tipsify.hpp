@@ -1,7 +1,9 @@
 #ifndef DIGGLER_TIPSIFY_HPP
 #define DIGGLER_TIPSIFY_HPP
 
-#include <vector>
+#include <cstddef>
+
+#include "../platform/Types.hpp"
 
 namespace Diggler {
 namespace Util {
@@ -9,15 +11,26 @@ namespace Util {
 class Tipsify {
 public:
   /**
-   * @brief Computes the Average Cache Miss Ratio for a given cache size and set of faces
-   * @param indices Face indices list
+   * @brief Computes the Average Cache Miss Ratio of a FIFO vertex cache for a triangle list
+   * @param indices Triangle list indices, 3 per face
+   * @param indexCount Number of indices
    * @param cacheSize Cache size (in vertex)
-   * @return ACMR
+   * @return ACMR, i.e. cache misses per triangle
    */
-  static double calcACMR(const std::vector<int[3]> &faces, int cacheSize);
+  template<typename IndexT>
+  static double calcACMR(const IndexT *indices, std::size_t indexCount, uint cacheSize);
 
-  static std::vector<int[3]> tipsify(std::size_t vertexCount,
-    const std::vector<int[3]> &indices, int cacheSize);
+  /**
+   * @brief Reorders a triangle list in place for better post-transform vertex cache usage
+   * Runs in linear time with respect to the vertex and index counts.
+   * @param indices Triangle list indices, 3 per face
+   * @param indexCount Number of indices
+   * @param vertexCount Number of vertices referenced by indices
+   * @param cacheSize Target cache size (in vertex)
+   */
+  template<typename IndexT>
+  static void tipsify(IndexT *indices, std::size_t indexCount, std::size_t vertexCount,
+    uint cacheSize);
 };
 
 }